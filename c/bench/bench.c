@@ -0,0 +1,546 @@
+///
+/// Microbenchmarks for the containers of this library.
+///
+/// Every benchmark runs over a matrix of sizes, element types and access
+/// patterns. Each case is run a few times to warm up, then timed over several
+/// trials, and the per-operation median and percentiles are reported.
+/// Hardware counters are read through perf_event_open when the kernel allows
+/// it, and reported as null otherwise.
+///
+/// Results are written as JSON on stdout, progress goes to stderr.
+///
+/// Usage: bench [--quick] [--trials N] [--filter SUBSTRING]
+///
+
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_bitvec.h"
+#include "list32i.h"
+#include "vec.h"
+
+#define WARMUP_TRIALS 2
+#define MAX_TRIALS 101
+
+typedef enum { PATTERN_SEQ, PATTERN_RANDOM } pattern_t;
+
+static const char *_pattern_names[] = {"seq", "random"};
+
+typedef struct {
+    const char *type;
+    uint8_t elsize;
+    int (*cmp)(const void *, const void *);
+} eltype_t;
+
+typedef struct {
+    const eltype_t *eltype;
+    size_t size;
+    pattern_t pattern;
+} params_t;
+
+typedef struct {
+    const char *name;
+    // Returns the state the benchmark runs on, can't be timed
+    void *(*setup)(const params_t *params);
+    // Timed part, returns the number of operations it did
+    size_t (*run)(void *state, const params_t *params);
+    void (*teardown)(void *state);
+    // Which parts of the matrix make sense for this benchmark
+    bool typed;
+    bool patterned;
+    size_t max_size;
+} bench_t;
+
+// ------------------------------------------- Utils
+
+static uint64_t _rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t _rand(void) {
+    // xorshift64*, deterministic so that runs can be compared
+    _rng_state ^= _rng_state >> 12;
+    _rng_state ^= _rng_state << 25;
+    _rng_state ^= _rng_state >> 27;
+    return _rng_state * 0x2545f4914f6cdd1d;
+}
+
+static uint64_t _now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// Indices in [0; size[ following the pattern
+static size_t *_indices(const params_t *params, size_t count) {
+    size_t *res = malloc(count * sizeof(size_t));
+    for (size_t i = 0; i < count; ++i) {
+        res[i] = params->pattern == PATTERN_SEQ ? i % params->size
+                                                : _rand() % params->size;
+    }
+    return res;
+}
+
+/// Writes the little endian representation of the ith of size sorted values
+/// on elsize bytes
+static void _write_el(uint8_t *dst, uint8_t elsize, size_t i, size_t size) {
+    uint64_t val = elsize > 1 ? i : i * 255 / size;
+    for (uint8_t b = 0; b < elsize; ++b) {
+        dst[b] = (uint8_t)(val >> (b * 8));
+    }
+}
+
+static int _cmp_u8(const void *a, const void *b) {
+    return *(const uint8_t *)a - *(const uint8_t *)b;
+}
+
+static int _cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int _cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static const eltype_t _eltypes[] = {
+    {"u8", 1, _cmp_u8},
+    {"u32", 4, _cmp_u32},
+    {"u64", 8, _cmp_u64},
+};
+
+// Keeps the compiler from optimizing away results
+static volatile uint64_t _sink;
+
+// ------------------------------------------- Hardware counters
+
+#define NCOUNTERS 4
+
+static const struct {
+    const char *name;
+    uint64_t config;
+} _counters[NCOUNTERS] = {
+    {"cycles", PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache_misses", PERF_COUNT_HW_CACHE_MISSES},
+    {"branch_misses", PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// -1 when the counter isn't available
+static int _counter_fds[NCOUNTERS] = {-1, -1, -1, -1};
+
+static void _counters_open(void) {
+    for (int i = 0; i < NCOUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = _counters[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+static void _counters_start(void) {
+    for (int i = 0; i < NCOUNTERS; ++i) {
+        if (_counter_fds[i] >= 0) {
+            ioctl(_counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(_counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void _counters_stop(uint64_t values[NCOUNTERS]) {
+    for (int i = 0; i < NCOUNTERS; ++i) {
+        values[i] = 0;
+        if (_counter_fds[i] >= 0) {
+            ioctl(_counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(_counter_fds[i], &values[i], sizeof(uint64_t)) !=
+                sizeof(uint64_t)) {
+                values[i] = 0;
+            }
+        }
+    }
+}
+
+// ------------------------------------------- Benchmarks
+
+typedef struct {
+    vec_t *vec;
+    size_t *indices;
+    size_t count;
+    uint8_t *vals;
+} vec_state_t;
+
+/// Vec filled with sorted values, with `count` indices and the
+/// values found at those indices
+static vec_state_t *_vec_setup(const params_t *params, size_t count) {
+    vec_state_t *state = malloc(sizeof(vec_state_t));
+    uint8_t elsize = params->eltype->elsize;
+
+    state->vec = vec_new(elsize, params->size, 0);
+    for (size_t i = 0; i < params->size; ++i) {
+        _write_el(&state->vec->data[i * elsize], elsize, i, params->size);
+    }
+    state->count = count;
+    state->indices = _indices(params, count);
+    state->vals = malloc(count * elsize);
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(&state->vals[i * elsize],
+               &state->vec->data[state->indices[i] * elsize], elsize);
+    }
+    return state;
+}
+
+static void _vec_teardown(void *arg) {
+    vec_state_t *state = arg;
+    vec_free(state->vec);
+    free(state->indices);
+    free(state->vals);
+    free(state);
+}
+
+static void *vec_append_setup(const params_t *params) {
+    return vec_new(params->eltype->elsize, 0, 0);
+}
+
+static size_t vec_append_run(void *arg, const params_t *params) {
+    vec_t *vec = arg;
+    uint8_t elsize = params->eltype->elsize;
+    uint64_t val = 0;
+
+    for (size_t i = 0; i < params->size; ++i) {
+        vec_append(vec, elsize, &val);
+        ++val;
+    }
+    return params->size;
+}
+
+static void vec_append_teardown(void *arg) {
+    vec_free(arg);
+}
+
+static void *vec_search_setup(const params_t *params) {
+    // Linear search, a handful of lookups is enough
+    return _vec_setup(params, 16);
+}
+
+static size_t vec_search_run(void *arg, const params_t *params) {
+    vec_state_t *state = arg;
+    uint8_t elsize = params->eltype->elsize;
+    for (size_t i = 0; i < state->count; ++i) {
+        _sink += vec_search(state->vec, elsize, &state->vals[i * elsize]);
+    }
+    return state->count;
+}
+
+static void *vec_search_binary_setup(const params_t *params) {
+    return _vec_setup(params, 100000);
+}
+
+static size_t vec_search_binary_run(void *arg, const params_t *params) {
+    vec_state_t *state = arg;
+    uint8_t elsize = params->eltype->elsize;
+    for (size_t i = 0; i < state->count; ++i) {
+        _sink += vec_search_binary(state->vec, elsize,
+                                   &state->vals[i * elsize],
+                                   params->eltype->cmp);
+    }
+    return state->count;
+}
+
+static void *vec_remove_setup(const params_t *params) {
+    // Every removal shifts the tail of the vec, keep the number small
+    return _vec_setup(params, 16);
+}
+
+static size_t vec_remove_run(void *arg, const params_t *params) {
+    vec_state_t *state = arg;
+    uint8_t elsize = params->eltype->elsize;
+    for (size_t i = 0; i < state->count; ++i) {
+        vec_remove(state->vec, elsize,
+                   state->indices[i] % (state->vec->size - 1));
+    }
+    return state->count;
+}
+
+typedef struct {
+    bitvec_t *vec;
+    size_t *indices;
+    bool *buff;
+} bitvec_state_t;
+
+static void *bitvec_setup(const params_t *params) {
+    bitvec_state_t *state = malloc(sizeof(bitvec_state_t));
+    state->vec = bitvec_new(params->size, 0);
+    state->indices = _indices(params, params->size);
+    state->buff = malloc(params->size);
+    for (size_t i = 0; i < params->size; ++i) {
+        state->buff[i] = _rand() & 1;
+    }
+    bitvec_pack(state->vec, 0, state->buff, params->size);
+    return state;
+}
+
+static void bitvec_teardown(void *arg) {
+    bitvec_state_t *state = arg;
+    bitvec_free(state->vec);
+    free(state->indices);
+    free(state->buff);
+    free(state);
+}
+
+static size_t bitvec_set_run(void *arg, const params_t *params) {
+    bitvec_state_t *state = arg;
+    for (size_t i = 0; i < params->size; ++i) {
+        bitvec_set(state->vec, state->indices[i], i & 1);
+    }
+    return params->size;
+}
+
+static size_t bitvec_get_run(void *arg, const params_t *params) {
+    bitvec_state_t *state = arg;
+    uint64_t count = 0;
+    for (size_t i = 0; i < params->size; ++i) {
+        count += bitvec_get(state->vec, state->indices[i]);
+    }
+    _sink += count;
+    return params->size;
+}
+
+static void *bitvec_search_setup(const params_t *params) {
+    // Worst case, the value isn't there
+    bitvec_state_t *state = bitvec_setup(params);
+    memset(state->buff, 0, params->size);
+    bitvec_pack(state->vec, 0, state->buff, params->size);
+    return state;
+}
+
+static size_t bitvec_search_run(void *arg, const params_t *params) {
+    bitvec_state_t *state = arg;
+    _sink += bitvec_search(state->vec, true);
+    return params->size;
+}
+
+static size_t bitvec_pack_run(void *arg, const params_t *params) {
+    bitvec_state_t *state = arg;
+    bitvec_pack(state->vec, 0, state->buff, params->size);
+    return params->size;
+}
+
+static size_t bitvec_unpack_run(void *arg, const params_t *params) {
+    bitvec_state_t *state = arg;
+    bitvec_unpack(state->vec, 0, state->buff, params->size);
+    return params->size;
+}
+
+static void *list32i_setup(const params_t *params) {
+    list32i_t *list = list32i_new();
+    for (size_t i = 0; i < params->size; ++i) {
+        list32i_push_back(list, i);
+    }
+    return list;
+}
+
+static void list32i_teardown(void *arg) {
+    list32i_t *list = arg;
+    // list32i_free pops from the back, which walks the whole list every time
+    while (list->length) {
+        list32i_pop_front(list);
+    }
+    list32i_free(list);
+}
+
+static size_t list32i_push_pop_run(void *arg, const params_t *params) {
+    list32i_t *list = arg;
+    for (size_t i = 0; i < params->size; ++i) {
+        list32i_push_back(list, i);
+    }
+    for (size_t i = 0; i < params->size; ++i) {
+        _sink += list32i_pop_front(list);
+    }
+    return params->size * 2;
+}
+
+static size_t list32i_get_idx_run(void *arg, const params_t *params) {
+    list32i_t *list = arg;
+    // Every get walks the list, keep the number of lookups small
+    size_t count = 64;
+    for (size_t i = 0; i < count; ++i) {
+        size_t idx = params->pattern == PATTERN_SEQ ? i : _rand();
+        _sink += list32i_get_idx(list, idx % params->size);
+    }
+    return count;
+}
+
+static const bench_t _benches[] = {
+    {"vec_append", vec_append_setup, vec_append_run, vec_append_teardown,
+     true, false, SIZE_MAX},
+    {"vec_search", vec_search_setup, vec_search_run, _vec_teardown, true,
+     true, SIZE_MAX},
+    {"vec_search_binary", vec_search_binary_setup, vec_search_binary_run,
+     _vec_teardown, true, true, SIZE_MAX},
+    {"vec_remove", vec_remove_setup, vec_remove_run, _vec_teardown, true,
+     true, SIZE_MAX},
+    {"bitvec_set", bitvec_setup, bitvec_set_run, bitvec_teardown, false,
+     true, SIZE_MAX},
+    {"bitvec_get", bitvec_setup, bitvec_get_run, bitvec_teardown, false,
+     true, SIZE_MAX},
+    {"bitvec_search", bitvec_search_setup, bitvec_search_run,
+     bitvec_teardown, false, false, SIZE_MAX},
+    {"bitvec_pack", bitvec_setup, bitvec_pack_run, bitvec_teardown, false,
+     false, SIZE_MAX},
+    {"bitvec_unpack", bitvec_setup, bitvec_unpack_run, bitvec_teardown,
+     false, false, SIZE_MAX},
+    {"list32i_push_pop", list32i_setup, list32i_push_pop_run,
+     list32i_teardown, false, false, SIZE_MAX},
+    {"list32i_get_idx", list32i_setup, list32i_get_idx_run, list32i_teardown,
+     false, true, 100000},
+};
+
+// ------------------------------------------- Harness
+
+static int _cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/// Nearest-rank percentile of a sorted array
+static double _percentile(const double *sorted, size_t n, double p) {
+    size_t rank = p / 100.0 * (n - 1) + 0.5;
+    return sorted[rank];
+}
+
+static void _run_case(const bench_t *bench, const params_t *params,
+                      size_t trials, bool *first) {
+    double ns_per_op[MAX_TRIALS];
+    double counters_per_op[NCOUNTERS][MAX_TRIALS];
+    size_t ops = 0;
+
+    for (size_t t = 0; t < WARMUP_TRIALS + trials; ++t) {
+        void *state = bench->setup(params);
+        uint64_t counters[NCOUNTERS];
+
+        _counters_start();
+        uint64_t start = _now_ns();
+        ops = bench->run(state, params);
+        uint64_t elapsed = _now_ns() - start;
+        _counters_stop(counters);
+
+        bench->teardown(state);
+        if (t < WARMUP_TRIALS) {
+            continue;
+        }
+        size_t trial = t - WARMUP_TRIALS;
+        ns_per_op[trial] = (double)elapsed / ops;
+        for (int c = 0; c < NCOUNTERS; ++c) {
+            counters_per_op[c][trial] = (double)counters[c] / ops;
+        }
+    }
+
+    qsort(ns_per_op, trials, sizeof(double), _cmp_double);
+
+    printf("%s\n    {\"name\": \"%s\", \"type\": ", *first ? "" : ",",
+           bench->name);
+    if (bench->typed) {
+        printf("\"%s\"", params->eltype->type);
+    } else {
+        printf("null");
+    }
+    printf(", \"size\": %zu, \"pattern\": ", params->size);
+    if (bench->patterned) {
+        printf("\"%s\"", _pattern_names[params->pattern]);
+    } else {
+        printf("null");
+    }
+    printf(", \"ops\": %zu, \"trials\": %zu,\n", ops, trials);
+    printf("     \"ns_per_op\": {\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+           "\"p99\": %.3f, \"max\": %.3f},\n",
+           ns_per_op[0], _percentile(ns_per_op, trials, 50),
+           _percentile(ns_per_op, trials, 90),
+           _percentile(ns_per_op, trials, 99), ns_per_op[trials - 1]);
+    printf("     \"counters_per_op_p50\": {");
+    for (int c = 0; c < NCOUNTERS; ++c) {
+        printf("%s\"%s\": ", c ? ", " : "", _counters[c].name);
+        if (_counter_fds[c] < 0) {
+            printf("null");
+            continue;
+        }
+        qsort(counters_per_op[c], trials, sizeof(double), _cmp_double);
+        printf("%.3f", _percentile(counters_per_op[c], trials, 50));
+    }
+    printf("}}");
+    fflush(stdout);
+    *first = false;
+}
+
+int main(int argc, char **argv) {
+    bool quick = false;
+    size_t trials = 11;
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc) {
+            trials = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--quick] [--trials N] [--filter SUBSTRING]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (trials < 1 || trials > MAX_TRIALS) {
+        fprintf(stderr, "trials must be in [1; %d]\n", MAX_TRIALS);
+        return 1;
+    }
+
+    const size_t sizes[] = {1000, 100000, 1000000};
+    const size_t nsizes = quick ? 2 : sizeof(sizes) / sizeof(sizes[0]);
+    const size_t neltypes = sizeof(_eltypes) / sizeof(_eltypes[0]);
+
+    _counters_open();
+
+    printf("{\"trials\": %zu, \"warmup_trials\": %d, \"results\": [", trials,
+           WARMUP_TRIALS);
+    bool first = true;
+    for (size_t b = 0; b < sizeof(_benches) / sizeof(_benches[0]); ++b) {
+        const bench_t *bench = &_benches[b];
+        if (filter && strstr(bench->name, filter) == NULL) {
+            continue;
+        }
+        fprintf(stderr, "%s\n", bench->name);
+        for (size_t s = 0; s < nsizes && sizes[s] <= bench->max_size; ++s) {
+            for (size_t e = 0; e < (bench->typed ? neltypes : 1); ++e) {
+                int npatterns = bench->patterned ? 2 : 1;
+                for (int p = PATTERN_SEQ; p < npatterns; ++p) {
+                    params_t params = {&_eltypes[e], sizes[s], p};
+                    _run_case(bench, &params, trials, &first);
+                }
+            }
+        }
+    }
+    printf("\n]}\n");
+
+    for (int i = 0; i < NCOUNTERS; ++i) {
+        if (_counter_fds[i] >= 0) {
+            close(_counter_fds[i]);
+        }
+    }
+    return 0;
+}
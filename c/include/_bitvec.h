@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef struct {
@@ -28,6 +29,7 @@ typedef struct {
 /// Always return a valid pointer. Panics in case of allocation error.
 bitvec_t *bitvec_new(size_t size, size_t capacity);
 
+/// O(n)
 /// Always return a valid pointer. Panics in case of allocation error.
 bitvec_t *bitvec_from_buff(const bool *buff, size_t size);
 
@@ -54,6 +56,25 @@ void bitvec_append(bitvec_t *vec, bool val);
 /// Panics if the index is out of bound
 void bitvec_remove(bitvec_t *vec, size_t index);
 
+/// O(n)
+/// Sets `n` entries starting at `index` from a buffer of `n` bytes, any
+/// non-zero byte being a 1. Works with both bool arrays and byte masks.
+/// Whole bytes are packed with SIMD compare + movemask when available.
+/// If the range is out of bound, it will extend the vector with zeros first
+/// This potentially reallocates the data field, don't keep any reference to
+/// the old vec->data pointer.
+void bitvec_pack(bitvec_t *vec, size_t index, const void *buff, size_t n);
+
+/// O(n)
+/// Writes `n` entries starting at `index` into `buff` as bools (0 or 1)
+/// Out of bound entries are written as false
+void bitvec_unpack(const bitvec_t *vec, size_t index, bool *buff, size_t n);
+
+/// O(n)
+/// Same as `bitvec_unpack` but writes a byte mask (0x00 or 0xff)
+void bitvec_unpack_mask(const bitvec_t *vec, size_t index, uint8_t *buff,
+                        size_t n);
+
 bool bitvec_eq(const bitvec_t *a, const bitvec_t *b);
 
 void bitvec_print(const bitvec_t *vec);
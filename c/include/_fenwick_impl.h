@@ -0,0 +1,168 @@
+///
+/// This file generates a Fenwick tree (binary indexed tree) for a certain
+/// type and operator, the same way _vec_impl.h generates typed vecs.
+///
+/// A Fenwick tree keeps n values and answers "combination of the first k
+/// values" in O(log n), while still allowing O(log n) point updates. It is as
+/// compact as it gets: one element per value, in a single array.
+///
+/// The macro TYPE should be set to the type of the values
+/// The macro NAME should be set to the prefix of all the functions that will
+/// be declared
+/// The macro OP(a, b) should combine two values. It must be associative and
+/// commutative, e.g. `((a) + (b))`
+/// The macro IDENTITY should be set to the neutral element of OP, e.g. `0`
+/// The macro INVERSE(a, b) is optional, and should undo OP, i.e.
+/// INVERSE(OP(a, b), b) == a, e.g. `((a) - (b))`. It enables range queries
+/// and assignments
+/// The macro VEC is optional, and should be set to the NAME of the typed vec
+/// of TYPE, e.g. `i64vec`. It enables building a tree from a typed vec
+///
+
+// NO INCLUDE GUARD - This header is made to be included multiple times with
+// different defined NAME, but including it twice with the same defined NAME
+// will break
+
+#ifndef TYPE
+// Note: This is just for my linter to understand this file, TYPE should always
+// be defined when including this file
+#    include <stdint.h>
+#    define TYPE int64_t
+#    define NAME fenwick64i
+#    define OP(a, b) ((a) + (b))
+#    define IDENTITY 0
+#    define INVERSE(a, b) ((a) - (b))
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "alloc.h"
+
+#define CONCAT_EVAL(a, b) CONCAT(a, b)
+#define CONCAT(a, b) a##b
+#define _NAME(suffix) CONCAT_EVAL(NAME, suffix)
+#define _PRIVATE(suffix) CONCAT_EVAL(_, _NAME(suffix))
+
+typedef struct {
+    // Zero based layout: node i holds the combination of the values in
+    // ](i & (i + 1)) - 1; i]
+    TYPE *_tree;
+    size_t size;
+} _NAME(_t);
+
+/// O(n)
+/// Returns a tree of `size` values, all set to IDENTITY
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline _NAME(_t) * _NAME(_new)(size_t size) {
+    _NAME(_t) *res = malloc_or_panic(sizeof(_NAME(_t)));
+    res->_tree = malloc_or_panic((size ? size : 1) * sizeof(TYPE));
+    for (size_t i = 0; i < size; ++i) {
+        res->_tree[i] = IDENTITY;
+    }
+    res->size = size;
+    return res;
+}
+
+/// O(n)
+/// Returns a tree holding the `size` values of `buff`
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline _NAME(_t) * _NAME(_from_buff)(const TYPE *buff, size_t size) {
+    _NAME(_t) *res = malloc_or_panic(sizeof(_NAME(_t)));
+    res->_tree = malloc_or_panic((size ? size : 1) * sizeof(TYPE));
+    memcpy(res->_tree, buff, size * sizeof(TYPE));
+    res->size = size;
+
+    // Each node pushes its total to its parent, which comes after it, so a
+    // single forward pass builds the whole tree
+    for (size_t i = 0; i < size; ++i) {
+        size_t parent = i | (i + 1);
+        if (parent < size) {
+            res->_tree[parent] = OP(res->_tree[parent], res->_tree[i]);
+        }
+    }
+    return res;
+}
+
+#ifdef VEC
+/// O(n)
+/// Returns a tree holding the values of `vec`
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline _NAME(_t) *
+    _NAME(_from_vec)(CONCAT_EVAL(VEC, _t) const *vec) {
+    return _NAME(_from_buff)(vec->data, vec->size);
+}
+#endif
+
+static inline void _NAME(_free)(_NAME(_t) * tree) {
+    free(tree->_tree);
+    free(tree);
+}
+
+static inline void _PRIVATE(_check_bound)(_NAME(_t) const *tree,
+                                          size_t index) {
+    if (index >= tree->size) {
+        fprintf(stderr, "Out of bound access of index [%zu] on size %zu\n",
+                index, tree->size);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// O(log n)
+/// Replaces value `index` with OP(value, `val`), e.g. adds `val` to it for a
+/// sum
+/// Panics if the index is out of bound
+static inline void _NAME(_update)(_NAME(_t) * tree, size_t index, TYPE val) {
+    _PRIVATE(_check_bound)(tree, index);
+    for (size_t i = index; i < tree->size; i |= i + 1) {
+        tree->_tree[i] = OP(tree->_tree[i], val);
+    }
+}
+
+/// O(log n)
+/// Returns the combination of the values in [0; end[, IDENTITY if empty
+/// `end` is clamped to the size of the tree
+static inline TYPE _NAME(_prefix)(_NAME(_t) const *tree, size_t end) {
+    TYPE res = IDENTITY;
+    if (end > tree->size) {
+        end = tree->size;
+    }
+    for (size_t i = end; i > 0; i &= i - 1) {
+        res = OP(res, tree->_tree[i - 1]);
+    }
+    return res;
+}
+
+#ifdef INVERSE
+/// O(log n)
+/// Returns the combination of the values in [begin; end[, IDENTITY if empty
+/// `end` is clamped to the size of the tree
+static inline TYPE _NAME(_range)(_NAME(_t) const *tree, size_t begin,
+                                 size_t end) {
+    if (end > tree->size) {
+        end = tree->size;
+    }
+    if (begin >= end) {
+        return IDENTITY;
+    }
+    return INVERSE(_NAME(_prefix)(tree, end), _NAME(_prefix)(tree, begin));
+}
+
+/// O(log n)
+/// Returns value `index`
+/// Panics if the index is out of bound
+static inline TYPE _NAME(_get)(_NAME(_t) const *tree, size_t index) {
+    _PRIVATE(_check_bound)(tree, index);
+    return _NAME(_range)(tree, index, index + 1);
+}
+
+/// O(log n)
+/// Replaces value `index` with `val`
+/// Panics if the index is out of bound
+static inline void _NAME(_set)(_NAME(_t) * tree, size_t index, TYPE val) {
+    _NAME(_update)(tree, index, INVERSE(val, _NAME(_get)(tree, index)));
+}
+#endif
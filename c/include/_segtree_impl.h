@@ -0,0 +1,164 @@
+///
+/// This file generates an iterative segment tree for a certain type and
+/// operator, the same way _vec_impl.h generates typed vecs.
+///
+/// A segment tree keeps n values and answers "combination of the values in
+/// [begin; end[" in O(log n) for any associative operator, including those
+/// without an inverse like min or max, while allowing O(log n) point updates.
+///
+/// It uses the bottom-up layout: a single array of 2n elements, the values
+/// being the leaves in [n; 2n[ and node i combining nodes 2i and 2i + 1.
+/// There is no padding to a power of two and no pointer, the leaves are
+/// contiguous, and the few top levels that every operation goes through stay
+/// in cache.
+///
+/// The macro TYPE should be set to the type of the values
+/// The macro NAME should be set to the prefix of all the functions that will
+/// be declared
+/// The macro OP(a, b) should combine two values. It must be associative, but
+/// needs not be commutative, e.g. `((a) < (b) ? (a) : (b))`
+/// The macro IDENTITY should be set to the neutral element of OP, e.g.
+/// `INT64_MAX` for a minimum
+/// The macro VEC is optional, and should be set to the NAME of the typed vec
+/// of TYPE, e.g. `i64vec`. It enables building a tree from a typed vec
+///
+
+// NO INCLUDE GUARD - This header is made to be included multiple times with
+// different defined NAME, but including it twice with the same defined NAME
+// will break
+
+#ifndef TYPE
+// Note: This is just for my linter to understand this file, TYPE should always
+// be defined when including this file
+#    include <stdint.h>
+#    define TYPE int64_t
+#    define NAME segtree64i
+#    define OP(a, b) ((a) < (b) ? (a) : (b))
+#    define IDENTITY INT64_MAX
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "alloc.h"
+
+#define CONCAT_EVAL(a, b) CONCAT(a, b)
+#define CONCAT(a, b) a##b
+#define _NAME(suffix) CONCAT_EVAL(NAME, suffix)
+#define _PRIVATE(suffix) CONCAT_EVAL(_, _NAME(suffix))
+
+typedef struct {
+    // 2 * size nodes, node 0 is unused
+    TYPE *_tree;
+    size_t size;
+} _NAME(_t);
+
+// Computes every internal node from its children, deepest first
+static inline void _NAME(_build)(_NAME(_t) * tree) {
+    for (size_t i = tree->size - 1; i > 0; --i) {
+        tree->_tree[i] = OP(tree->_tree[2 * i], tree->_tree[2 * i + 1]);
+    }
+}
+
+/// O(n)
+/// Returns a tree of `size` values, all set to IDENTITY
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline _NAME(_t) * _NAME(_new)(size_t size) {
+    _NAME(_t) *res = malloc_or_panic(sizeof(_NAME(_t)));
+    res->_tree = malloc_or_panic((size ? 2 * size : 1) * sizeof(TYPE));
+    for (size_t i = 0; i < 2 * size; ++i) {
+        res->_tree[i] = IDENTITY;
+    }
+    res->size = size;
+    return res;
+}
+
+/// O(n)
+/// Returns a tree holding the `size` values of `buff`
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline _NAME(_t) * _NAME(_from_buff)(const TYPE *buff, size_t size) {
+    _NAME(_t) *res = malloc_or_panic(sizeof(_NAME(_t)));
+    res->_tree = malloc_or_panic((size ? 2 * size : 1) * sizeof(TYPE));
+    memcpy(res->_tree + size, buff, size * sizeof(TYPE));
+    res->size = size;
+    if (size > 0) {
+        _NAME(_build)(res);
+    }
+    return res;
+}
+
+#ifdef VEC
+/// O(n)
+/// Returns a tree holding the values of `vec`
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline _NAME(_t) *
+    _NAME(_from_vec)(CONCAT_EVAL(VEC, _t) const *vec) {
+    return _NAME(_from_buff)(vec->data, vec->size);
+}
+#endif
+
+static inline void _NAME(_free)(_NAME(_t) * tree) {
+    free(tree->_tree);
+    free(tree);
+}
+
+static inline void _PRIVATE(_check_bound)(_NAME(_t) const *tree,
+                                          size_t index) {
+    if (index >= tree->size) {
+        fprintf(stderr, "Out of bound access of index [%zu] on size %zu\n",
+                index, tree->size);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// O(1)
+/// Returns value `index`
+/// Panics if the index is out of bound
+static inline TYPE _NAME(_get)(_NAME(_t) const *tree, size_t index) {
+    _PRIVATE(_check_bound)(tree, index);
+    return tree->_tree[tree->size + index];
+}
+
+/// O(log n)
+/// Replaces value `index` with `val`
+/// Panics if the index is out of bound
+static inline void _NAME(_set)(_NAME(_t) * tree, size_t index, TYPE val) {
+    _PRIVATE(_check_bound)(tree, index);
+    size_t i = tree->size + index;
+    tree->_tree[i] = val;
+    for (i /= 2; i > 0; i /= 2) {
+        tree->_tree[i] = OP(tree->_tree[2 * i], tree->_tree[2 * i + 1]);
+    }
+}
+
+/// O(log n)
+/// Returns the combination of the values in [begin; end[, in order, or
+/// IDENTITY if empty
+/// `end` is clamped to the size of the tree
+static inline TYPE _NAME(_query)(_NAME(_t) const *tree, size_t begin,
+                                 size_t end) {
+    // Both sides are accumulated separately to keep the order of operands
+    TYPE left = IDENTITY;
+    TYPE right = IDENTITY;
+    if (end > tree->size) {
+        end = tree->size;
+    }
+    if (begin >= end) {
+        return IDENTITY;
+    }
+    for (begin += tree->size, end += tree->size; begin < end;
+         begin /= 2, end /= 2) {
+        if (begin & 1) {
+            left = OP(left, tree->_tree[begin]);
+            ++begin;
+        }
+        if (end & 1) {
+            --end;
+            right = OP(tree->_tree[end], right);
+        }
+    }
+    return OP(left, right);
+}
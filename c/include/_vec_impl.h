@@ -30,11 +30,26 @@
 #endif
 
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
+#include "_bitvec.h"
+
 #define CONCAT_EVAL(a, b) CONCAT(a, b)
 #define CONCAT(a, b) a##b
 #define _NAME(suffix) CONCAT_EVAL(NAME, suffix)
+// Helpers that aren't part of the API get a leading underscore
+#define _PRIVATE(suffix) CONCAT_EVAL(_, _NAME(suffix))
+
+#ifndef VEC_GALLOP_RATIO
+// Above this size ratio between two sorted sets, galloping through the larger
+// one beats merging both
+#    define VEC_GALLOP_RATIO 32
+#endif
+#ifndef VEC_SET_BLOCK
+// Number of elements of each side compared all against all in block merges
+#    define VEC_SET_BLOCK 8
+#endif
 
 typedef struct {
     TYPE *data;
@@ -61,6 +76,10 @@ static inline void _NAME(_append)(_NAME(_t) * vec, TYPE val) {
     vec_append((vec_t *)vec, sizeof(TYPE), &val);
 }
 
+static inline void _NAME(_reserve)(_NAME(_t) * vec, size_t capacity) {
+    vec_reserve((vec_t *)vec, sizeof(TYPE), capacity);
+}
+
 static inline void _NAME(_remove)(_NAME(_t) * vec, size_t index) {
     vec_remove((vec_t *)vec, sizeof(TYPE), index);
 }
@@ -87,3 +106,339 @@ static inline void _NAME(_bubble_sort)(_NAME(_t) const *vec,
                                        int (*cmp)(const void *, const void *)) {
     return vec_bubble_sort((const vec_t *)vec, sizeof(TYPE), cmp);
 }
+
+/// O(n)
+/// Returns a bitvec where entry i is set when `pred(&vec->data[i])` is true
+/// Scalar fallback for conditions only known at run time: `pred` is called
+/// through a pointer for every element, which keeps the loop from being
+/// vectorized. Prefer NAME_bitvec_<op> or vec_bitvec_where otherwise.
+/// Always return a valid pointer. Panics in case of allocation error.
+static inline bitvec_t *_NAME(_bitvec_from_predicate)(
+    _NAME(_t) const *vec, bool (*pred)(const void *)) {
+    bitvec_t *res = bitvec_new(vec->size, 0);
+    bool chunk[256];
+    for (size_t i = 0; i < vec->size; i += sizeof(chunk)) {
+        size_t n = vec->size - i;
+        if (n > sizeof(chunk)) {
+            n = sizeof(chunk);
+        }
+        for (size_t j = 0; j < n; ++j) {
+            chunk[j] = pred(&vec->data[i + j]);
+        }
+        bitvec_pack(res, i, chunk, n);
+    }
+    return res;
+}
+
+// Comparisons against a single value are done on a small chunk of bools the
+// compiler can vectorize, then packed into the result with bitvec_pack
+#define _VEC_BITVEC_CMP(suffix, op)                                            \
+    static inline bitvec_t *_NAME(suffix)(_NAME(_t) const *vec, TYPE val) {    \
+        bitvec_t *res = bitvec_new(vec->size, 0);                              \
+        bool chunk[256];                                                       \
+        for (size_t i = 0; i < vec->size; i += sizeof(chunk)) {                \
+            size_t n = vec->size - i;                                          \
+            if (n > sizeof(chunk)) {                                           \
+                n = sizeof(chunk);                                             \
+            }                                                                  \
+            for (size_t j = 0; j < n; ++j) {                                   \
+                chunk[j] = vec->data[i + j] op val;                            \
+            }                                                                  \
+            bitvec_pack(res, i, chunk, n);                                     \
+        }                                                                      \
+        return res;                                                            \
+    }
+
+/// O(n)
+/// Returns a bitvec where entry i is set when `vec->data[i] <op> val`, e.g.
+/// `i32vec_bitvec_gt(vec, 3)` is the bitmap of elements greater than 3
+/// Always return a valid pointer. Panics in case of allocation error.
+_VEC_BITVEC_CMP(_bitvec_eq, ==)
+_VEC_BITVEC_CMP(_bitvec_ne, !=)
+_VEC_BITVEC_CMP(_bitvec_lt, <)
+_VEC_BITVEC_CMP(_bitvec_le, <=)
+_VEC_BITVEC_CMP(_bitvec_gt, >)
+_VEC_BITVEC_CMP(_bitvec_ge, >=)
+
+#undef _VEC_BITVEC_CMP
+
+/// O(log d) where d is the distance between `from` and the result
+/// Returns the first index in [from; size[ whose value isn't lower than `val`,
+/// or `size` if there isn't any. `data` must be sorted
+static inline size_t _PRIVATE(_gallop)(const TYPE *data, size_t from,
+                                       size_t size, TYPE val) {
+    size_t lo = from;
+    size_t hi = from;
+    size_t step = 1;
+    while (hi < size && data[hi] < val) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > size) {
+        hi = size;
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (data[mid] < val) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Sets `found[p]` when a[p] is somewhere in b, both being VEC_SET_BLOCK long.
+// Every pair is compared without any branch so that the compiler can turn
+// this into a few vector compares
+static inline void _PRIVATE(_block_match)(const TYPE *a, const TYPE *b,
+                                          bool *found) {
+    for (size_t p = 0; p < VEC_SET_BLOCK; ++p) {
+        bool match = false;
+        for (size_t q = 0; q < VEC_SET_BLOCK; ++q) {
+            match |= a[p] == b[q];
+        }
+        found[p] |= match;
+    }
+}
+
+// Every write below lands at or before the index of the element being
+// written, and only overwrites values lower than it, which are never read
+// again. That's what makes `out` safe to alias an input
+static inline size_t _PRIVATE(_intersect_merge)(const TYPE *a, size_t na,
+                                                const TYPE *b, size_t nb,
+                                                TYPE *out) {
+    size_t i = 0, j = 0, k = 0;
+
+    while (i + VEC_SET_BLOCK <= na && j + VEC_SET_BLOCK <= nb) {
+        bool found[VEC_SET_BLOCK] = {false};
+        _PRIVATE(_block_match)(a + i, b + j, found);
+        for (size_t p = 0; p < VEC_SET_BLOCK; ++p) {
+            if (found[p]) {
+                out[k++] = a[i + p];
+            }
+        }
+        TYPE amax = a[i + VEC_SET_BLOCK - 1];
+        TYPE bmax = b[j + VEC_SET_BLOCK - 1];
+        i += amax <= bmax ? VEC_SET_BLOCK : 0;
+        j += bmax <= amax ? VEC_SET_BLOCK : 0;
+    }
+    while (i < na && j < nb) {
+        TYPE x = a[i];
+        TYPE y = b[j];
+        if (x == y) {
+            out[k++] = x;
+        }
+        i += x <= y;
+        j += y <= x;
+    }
+    return k;
+}
+
+// Walks the small set and gallops through the large one
+static inline size_t _PRIVATE(_intersect_gallop)(const TYPE *small, size_t ns,
+                                                 const TYPE *large, size_t nl,
+                                                 TYPE *out) {
+    size_t j = 0, k = 0;
+
+    for (size_t i = 0; i < ns && j < nl; ++i) {
+        j = _PRIVATE(_gallop)(large, j, nl, small[i]);
+        if (j < nl && large[j] == small[i]) {
+            out[k++] = small[i];
+        }
+    }
+    return k;
+}
+
+/// O(n + m) or O(min(n, m) * log(max(n, m))) when sizes are far apart
+/// Writes the elements present in both `a` and `b` into `out`, replacing its
+/// content. Inputs must be sorted sets, i.e. sorted without duplicates
+/// `out` may be `a` or `b`, the intersection is then done in place
+/// Panics in case of allocation error.
+static inline void _NAME(_intersect)(_NAME(_t) const *a, _NAME(_t) const *b,
+                                     _NAME(_t) * out) {
+    size_t na = a->size;
+    size_t nb = b->size;
+
+    // Can't reallocate an aliased input, its capacity is already big enough
+    _NAME(_reserve)(out, na < nb ? na : nb);
+    if (na / VEC_GALLOP_RATIO > nb) {
+        out->size = _PRIVATE(_intersect_gallop)(b->data, nb, a->data, na,
+                                                out->data);
+    } else if (nb / VEC_GALLOP_RATIO > na) {
+        out->size = _PRIVATE(_intersect_gallop)(a->data, na, b->data, nb,
+                                                out->data);
+    } else {
+        out->size = _PRIVATE(_intersect_merge)(a->data, na, b->data, nb,
+                                               out->data);
+    }
+}
+
+/// O(n + m) or O(min(n, m) * log(max(n, m))) when sizes are far apart
+/// Writes the elements present in `a`, `b` or both into `out`, replacing its
+/// content. Inputs must be sorted sets, i.e. sorted without duplicates
+/// `out` must not be `a` nor `b`
+/// Panics in case of allocation error.
+static inline void _NAME(_union)(_NAME(_t) const *a, _NAME(_t) const *b,
+                                 _NAME(_t) * out) {
+    const TYPE *small = a->data;
+    const TYPE *large = b->data;
+    size_t ns = a->size;
+    size_t nl = b->size;
+    size_t i = 0, j = 0, k = 0;
+
+    _NAME(_reserve)(out, ns + nl);
+    if (ns > nl) {
+        small = b->data;
+        large = a->data;
+        ns = b->size;
+        nl = a->size;
+    }
+
+    if (nl / VEC_GALLOP_RATIO > ns) {
+        // Whole runs of the large set are copied between small elements
+        for (; i < ns; ++i) {
+            size_t end = _PRIVATE(_gallop)(large, j, nl, small[i]);
+            memcpy(out->data + k, large + j, (end - j) * sizeof(TYPE));
+            k += end - j;
+            j = end;
+            if (j == nl || large[j] != small[i]) {
+                out->data[k++] = small[i];
+            }
+        }
+    } else {
+        while (i < ns && j < nl) {
+            TYPE x = small[i];
+            TYPE y = large[j];
+            out->data[k++] = x < y ? x : y;
+            i += x <= y;
+            j += y <= x;
+        }
+    }
+    memcpy(out->data + k, small + i, (ns - i) * sizeof(TYPE));
+    k += ns - i;
+    memcpy(out->data + k, large + j, (nl - j) * sizeof(TYPE));
+    k += nl - j;
+    out->size = k;
+}
+
+static inline size_t _PRIVATE(_difference_merge)(const TYPE *a, size_t na,
+                                                 const TYPE *b, size_t nb,
+                                                 TYPE *out) {
+    size_t i = 0, j = 0, k = 0;
+    // Matches of the current block of a, accumulated until it is done with
+    bool found[VEC_SET_BLOCK] = {false};
+
+    while (i + VEC_SET_BLOCK <= na && j + VEC_SET_BLOCK <= nb) {
+        _PRIVATE(_block_match)(a + i, b + j, found);
+        TYPE amax = a[i + VEC_SET_BLOCK - 1];
+        TYPE bmax = b[j + VEC_SET_BLOCK - 1];
+        j += bmax <= amax ? VEC_SET_BLOCK : 0;
+        if (amax <= bmax) {
+            for (size_t p = 0; p < VEC_SET_BLOCK; ++p) {
+                if (!found[p]) {
+                    out[k++] = a[i + p];
+                }
+                found[p] = false;
+            }
+            i += VEC_SET_BLOCK;
+        }
+    }
+    // The current block of a may be partially matched already
+    size_t done = i;
+    while (i < na && j < nb) {
+        TYPE x = a[i];
+        TYPE y = b[j];
+        if (x < y) {
+            if (i - done >= VEC_SET_BLOCK || !found[i - done]) {
+                out[k++] = x;
+            }
+            ++i;
+        } else if (y < x) {
+            ++j;
+        } else {
+            ++i;
+            ++j;
+        }
+    }
+    for (; i < na; ++i) {
+        if (i - done >= VEC_SET_BLOCK || !found[i - done]) {
+            out[k++] = a[i];
+        }
+    }
+    return k;
+}
+
+/// O(n + m) or O(min(n, m) * log(max(n, m))) when sizes are far apart
+/// Writes the elements of `a` that aren't in `b` into `out`, replacing its
+/// content. Inputs must be sorted sets, i.e. sorted without duplicates
+/// `out` may be `a`, the difference is then done in place
+/// Panics in case of allocation error.
+static inline void _NAME(_difference)(_NAME(_t) const *a, _NAME(_t) const *b,
+                                      _NAME(_t) * out) {
+    const TYPE *ad = a->data;
+    const TYPE *bd = b->data;
+    size_t na = a->size;
+    size_t nb = b->size;
+    size_t i = 0, j = 0, k = 0;
+
+    _NAME(_reserve)(out, na);
+    if (nb / VEC_GALLOP_RATIO > na) {
+        for (; i < na; ++i) {
+            j = _PRIVATE(_gallop)(bd, j, nb, ad[i]);
+            if (j == nb || bd[j] != ad[i]) {
+                out->data[k++] = ad[i];
+            }
+        }
+    } else if (na / VEC_GALLOP_RATIO > nb) {
+        // Whole runs of a are moved between elements of b
+        for (; j < nb && i < na; ++j) {
+            size_t end = _PRIVATE(_gallop)(ad, i, na, bd[j]);
+            memmove(out->data + k, ad + i, (end - i) * sizeof(TYPE));
+            k += end - i;
+            i = end;
+            if (i < na && ad[i] == bd[j]) {
+                ++i;
+            }
+        }
+        memmove(out->data + k, ad + i, (na - i) * sizeof(TYPE));
+        k += na - i;
+    } else {
+        k = _PRIVATE(_difference_merge)(ad, na, bd, nb, out->data);
+    }
+    out->size = k;
+}
+
+/// O(n * k) at worst for k sets of at most n elements, usually much less
+/// since each step works on the shrinking result
+/// Writes the elements present in all the `n` sets of `vecs` into `out`,
+/// replacing its content. The smallest set is the starting point and the
+/// others are intersected with the result in order, stopping early once it
+/// is empty. Inputs must be sorted sets, i.e. sorted without duplicates
+/// `out` must not be one of `vecs`
+/// Panics in case of allocation error.
+static inline void _NAME(_intersect_many)(_NAME(_t) const *const *vecs,
+                                          size_t n, _NAME(_t) * out) {
+    out->size = 0;
+    if (n == 0) {
+        return;
+    }
+
+    size_t smallest = 0;
+    for (size_t i = 1; i < n; ++i) {
+        if (vecs[i]->size < vecs[smallest]->size) {
+            smallest = i;
+        }
+    }
+    _NAME(_reserve)(out, vecs[smallest]->size);
+    memcpy(out->data, vecs[smallest]->data,
+           vecs[smallest]->size * sizeof(TYPE));
+    out->size = vecs[smallest]->size;
+
+    for (size_t i = 0; i < n && out->size > 0; ++i) {
+        if (i != smallest) {
+            _NAME(_intersect)(out, vecs[i], out);
+        }
+    }
+}
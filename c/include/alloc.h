@@ -21,3 +21,8 @@ void *calloc_or_panic(size_t nmemb, size_t size) __attribute_malloc__
 /// Same as realloc(2) but panics in case of allocation error
 void *realloc_or_panic(void *ptr, size_t size) __attribute_warn_unused_result__
     __attribute_alloc_size__((2));
+
+/// Same as aligned_alloc(3) but panics in case of allocation error
+/// `size` is rounded up to a multiple of `alignment`
+void *aligned_alloc_or_panic(size_t alignment, size_t size) __attribute_malloc__
+    __attribute_alloc_size__((2)) __wur;
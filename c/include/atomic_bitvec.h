@@ -0,0 +1,68 @@
+///
+/// Fixed-capacity bitmap that can be shared between threads without locks,
+/// e.g. as the visited set of a multi-threaded graph traversal.
+/// Unlike bitvec_t, the storage never moves and every write is an atomic
+/// read-modify-write on a 64-bit word.
+///
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "_bitvec.h"
+
+typedef struct {
+    // Use the atomic_bitvec_* functions to interract with the data
+    // Entry i is bit (i % 64) of word (i / 64), bits past size are always 0
+    _Atomic uint64_t *_words;
+    // Size in number of elements, fixed at creation
+    size_t size;
+} atomic_bitvec_t;
+
+/// Returns a bitvec of given size with all zero elements
+/// Always return a valid pointer. Panics in case of allocation error.
+atomic_bitvec_t *atomic_bitvec_new(size_t size);
+
+/// Not thread safe, all other threads must be done with the vec
+void atomic_bitvec_free(atomic_bitvec_t *vec);
+
+/// O(1)
+/// Sets the entry and returns its previous value, so exactly one of several
+/// threads setting the same entry sees false.
+/// `order` applies to the read-modify-write: memory_order_relaxed is enough for
+/// a plain visited set, memory_order_acq_rel also publishes what was written
+/// before setting the entry to whoever sees it set.
+/// Panics if the index is out of bound
+bool atomic_bitvec_test_and_set(atomic_bitvec_t *vec, size_t index,
+                                memory_order order);
+
+/// O(1)
+/// Clears the entry and returns its previous value
+/// Panics if the index is out of bound
+bool atomic_bitvec_test_and_clear(atomic_bitvec_t *vec, size_t index,
+                                  memory_order order);
+
+/// O(1)
+/// Release orderings are weakened to what a load supports
+/// If the index is out of bound, return false
+bool atomic_bitvec_get(const atomic_bitvec_t *vec, size_t index,
+                       memory_order order);
+
+/// O(n)
+/// Sets all given entries and returns how many of them were not already set.
+/// Consecutive indices falling in the same word are merged into a single
+/// atomic operation, so sorted indices are much cheaper.
+/// Panics if an index is out of bound
+size_t atomic_bitvec_set_many(atomic_bitvec_t *vec, const size_t *indices,
+                              size_t n, memory_order order);
+
+/// O(n)
+/// Copies the current state into a new plain bitvec.
+/// Each word is read atomically, but the snapshot as a whole is not atomic
+/// with regard to concurrent writers.
+/// Always return a valid pointer. Panics in case of allocation error.
+bitvec_t *atomic_bitvec_snapshot(const atomic_bitvec_t *vec,
+                                 memory_order order);
@@ -0,0 +1,86 @@
+///
+/// Blocked Bloom filter on top of a bitvec.
+/// The bitmap is split into 64-byte blocks (one cache line), and all the k
+/// bits of a key land in the same block, one in each of k of its 16 32-bit
+/// words, the words being picked from the hash. A query therefore costs a
+/// single cache miss whatever k is, at the price of a slightly higher false
+/// positive rate than a classic Bloom filter for the same size.
+///
+/// Keys are given as 64-bit hashes, use `bloom_hash` or any well distributed
+/// hash function.
+///
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "_bitvec.h"
+
+#define BLOOM_BLOCK_BITS 512
+#define BLOOM_MAX_K 16
+
+typedef struct {
+    // 64-byte aligned array of blocks of 16 32-bit words each
+    // Don't resize it, its size is fixed at creation
+    bitvec_t *bits;
+    size_t nblocks;
+    // Number of bits set per key, in [1; BLOOM_MAX_K]
+    uint8_t k;
+} bloom_t;
+
+/// Returns an empty filter of at least `nbits` bits, setting `k` bits per key
+/// k is clamped to [1; BLOOM_MAX_K]
+/// Always return a valid pointer. Panics in case of allocation error.
+bloom_t *bloom_new(size_t nbits, uint8_t k);
+
+/// Returns an empty filter sized to hold `n` keys with a false positive rate
+/// of at most `fpp`
+/// Always return a valid pointer. Panics in case of allocation error.
+bloom_t *bloom_new_for(size_t n, double fpp);
+
+void bloom_free(bloom_t *bloom);
+
+/// Number of bits a filter needs to hold `n` keys with a false positive rate
+/// of at most `fpp`, accounting for the blocked layout
+size_t bloom_nbits_for(size_t n, double fpp);
+
+/// Number of bits per key giving the lowest false positive rate for a filter
+/// of `nbits` bits holding `n` keys, accounting for the blocked layout
+uint8_t bloom_k_for(size_t nbits, size_t n);
+
+/// Expected false positive rate of the filter once it holds `n` keys
+double bloom_fpp(const bloom_t *bloom, size_t n);
+
+/// Hashes arbitrary bytes into a key suitable for the filter
+uint64_t bloom_hash(const void *key, size_t len);
+
+/// O(1)
+void bloom_insert(bloom_t *bloom, uint64_t hash);
+
+/// O(1)
+/// Returns false if the key was never inserted, true if it probably was
+bool bloom_query(const bloom_t *bloom, uint64_t hash);
+
+/// O(n)
+/// Same as calling `bloom_insert` on each hash, but prefetches blocks ahead
+void bloom_insert_many(bloom_t *bloom, const uint64_t *hashes, size_t n);
+
+/// O(n)
+/// Same as calling `bloom_query` on each hash and writing the result in `out`,
+/// but prefetches blocks ahead
+void bloom_query_many(const bloom_t *bloom, const uint64_t *hashes, size_t n,
+                      bool *out);
+
+/// Size in bytes of the serialized filter
+size_t bloom_serialized_size(const bloom_t *bloom);
+
+/// Writes `bloom_serialized_size(bloom)` bytes into `buff`
+/// The format is portable across endianness
+void bloom_serialize(const bloom_t *bloom, void *buff);
+
+/// Reads back a filter written by `bloom_serialize`
+/// Returns NULL if the buffer isn't a valid serialized filter
+/// Panics in case of allocation error.
+bloom_t *bloom_deserialize(const void *buff, size_t len);
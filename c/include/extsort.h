@@ -0,0 +1,45 @@
+///
+/// External merge sort, for files of fixed-size records too large to be
+/// sorted in memory.
+///
+/// A record file is simply the `size * elsize` bytes of a vec_t data field,
+/// so a vec written with a single write(2) can be sorted, and the result read
+/// back into a vec.
+///
+/// The input is read in chunks that fit the memory budget, each chunk is
+/// sorted with qsort(3) and spilled as a sorted run to an unlinked temporary
+/// file, then runs are merged with a loser tree. When there are too many runs
+/// to give each one a large enough buffer, groups of runs are first merged
+/// into longer ones.
+///
+/// All I/O is done with large sequential reads and writes, and the kernel is
+/// asked to prefetch the next block of each run while the current one is
+/// being merged.
+///
+
+#pragma once
+
+#include <sys/types.h>
+
+typedef struct {
+    // Size in bytes of a record
+    size_t elsize;
+    // Same as qsort(3), ties keep no particular order
+    int (*cmp)(const void *, const void *);
+    // Maximum number of bytes used for buffers, 0 for
+    // EXTSORT_DEFAULT_MEM_BUDGET
+    size_t mem_budget;
+    // Directory for the temporary file, NULL for $TMPDIR or /tmp
+    const char *tmpdir;
+} extsort_config_t;
+
+#define EXTSORT_DEFAULT_MEM_BUDGET ((size_t)64 << 20)
+
+/// O(n log n) comparisons, O(n log_k n) I/O where k is the merge fan-in
+/// Sorts the records of the file at `in_path` into the file at `out_path`,
+/// which is created or truncated. Both paths can be the same file.
+/// Returns 0 on success, or -1 with errno set on error. The file size not
+/// being a multiple of `elsize` is reported with EINVAL.
+/// Panics in case of allocation error.
+int extsort_file(const char *in_path, const char *out_path,
+                 const extsort_config_t *config);
@@ -0,0 +1,43 @@
+///
+/// Optional hot path counters, to see what the containers are doing inside a
+/// slow service: how many reallocations, how many bytes shifted around, how
+/// long the searches and list walks are...
+///
+/// Build with DSALGO_INSTRUMENT defined (`make INSTRUMENT=1`) to enable them.
+/// Otherwise the INSTR_ADD macro expands to nothing and snapshots are all
+/// zeros, so there is no overhead at all.
+///
+/// Counters are thread local, a snapshot only shows what the calling thread
+/// did since its last reset.
+///
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    // Calls to malloc_or_panic, calloc_or_panic and aligned_alloc_or_panic
+    uint64_t allocs;
+    // Calls to realloc_or_panic
+    uint64_t reallocs;
+    // Bytes copied or shifted by the containers themselves
+    uint64_t bytes_copied;
+    // Elements compared by searches and sorts
+    uint64_t probes;
+    // Nodes walked through to reach an index in linked lists
+    uint64_t node_hops;
+} instr_counters_t;
+
+/// Counters of the calling thread
+instr_counters_t instr_snapshot(void);
+
+/// Zeroes the counters of the calling thread
+void instr_reset(void);
+
+#ifdef DSALGO_INSTRUMENT
+extern _Thread_local instr_counters_t _instr_counters;
+// `n` must not have side effects, it isn't evaluated when disabled
+#    define INSTR_ADD(counter, n) (_instr_counters.counter += (n))
+#else
+#    define INSTR_ADD(counter, n) ((void)0)
+#endif
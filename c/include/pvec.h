@@ -0,0 +1,89 @@
+///
+/// Persistent growable array: taking a snapshot is O(1), and the snapshot
+/// keeps seeing the same elements whatever happens to the original.
+///
+/// Elements live in fixed-size chunks, reached through a directory of chunk
+/// pointers. Snapshots share the directory and the chunks, which are
+/// reference counted. A write first makes a private copy of the directory if
+/// it is shared, then of the chunk it touches if that one is shared, so a
+/// write after a snapshot copies one chunk and the directory, not the whole
+/// array.
+///
+/// Each handle must only be used by one thread at a time, but handles sharing
+/// data can be used and freed from different threads without any lock: a
+/// writer never waits for the readers of its snapshots.
+///
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "vec.h"
+
+// Chunks hold as many elements as fit in this many bytes, rounded down to a
+// power of two, and at least one
+#define PVEC_CHUNK_BYTES 4096
+
+typedef struct {
+    // Number of directories pointing to this chunk
+    _Atomic size_t refs;
+    _Alignas(max_align_t) uint8_t data[];
+} pvec_chunk_t;
+
+typedef struct {
+    // Number of pvec_t pointing to this directory
+    _Atomic size_t refs;
+    size_t nchunks;
+    size_t cap;
+    pvec_chunk_t *chunks[];
+} pvec_dir_t;
+
+typedef struct {
+    pvec_dir_t *_dir;
+    // Number of element
+    size_t size;
+    size_t elsize;
+    // Chunks hold 1 << _chunk_shift elements
+    uint8_t _chunk_shift;
+} pvec_t;
+
+/// Returns an empty pvec
+/// Always return a valid pointer. Panics in case of allocation error, or if
+/// `elsize` is 0.
+pvec_t *pvec_new(size_t elsize);
+
+/// O(n)
+/// Returns a pvec holding a copy of the elements of `vec`
+/// Always return a valid pointer. Panics in case of allocation error.
+pvec_t *pvec_from_vec(const vec_t *vec, uint8_t elsize);
+
+/// Chunks are only freed once no other snapshot uses them
+void pvec_free(pvec_t *vec);
+
+/// O(1)
+/// Returns a new handle on the current content of `vec`. Later writes to any
+/// of the two handles aren't seen by the other one.
+/// Always return a valid pointer. Panics in case of allocation error.
+pvec_t *pvec_snapshot(const pvec_t *vec);
+
+/// O(1)
+/// Returns a pointer to element `index`, valid until the next write to `vec`
+/// Panics if the index is out of bound
+const void *pvec_at(const pvec_t *vec, size_t index);
+
+/// O(1) if the chunk isn't shared, else O(PVEC_CHUNK_BYTES + n / chunk size)
+/// Replaces element `index` with the `elsize` bytes at `data`
+/// Panics if the index is out of bound, or in case of allocation error.
+void pvec_set(pvec_t *vec, size_t index, const void *data);
+
+/// O(1) amortized, with the same copies as `pvec_set` when shared
+/// Panics in case of allocation error.
+void pvec_append(pvec_t *vec, const void *data);
+
+/// O(n)
+/// Returns a regular vec holding a copy of the elements
+/// Always return a valid pointer. Panics in case of allocation error.
+vec_t *pvec_to_vec(const pvec_t *vec);
@@ -0,0 +1,93 @@
+///
+/// Structures answering queries over ranges of a numeric array that gets
+/// point updates, without rescanning the range each time.
+///
+/// - Fenwick trees for prefix and range sums, see _fenwick_impl.h
+/// - Segment trees for range minimum and maximum, see _segtree_impl.h
+///
+/// Both are templates, you are encouraged to generate your own variations for
+/// other types and operators.
+///
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include "vec.h"
+
+#define TYPE int64_t
+#define NAME i64fenwick
+#define OP(a, b) ((a) + (b))
+#define IDENTITY 0
+#define INVERSE(a, b) ((a) - (b))
+#define VEC i64vec
+#include "_fenwick_impl.h"
+#undef TYPE
+#undef NAME
+#undef OP
+#undef IDENTITY
+#undef INVERSE
+#undef VEC
+
+#define TYPE double
+#define NAME dfenwick
+#define OP(a, b) ((a) + (b))
+#define IDENTITY 0.0
+#define INVERSE(a, b) ((a) - (b))
+#define VEC dvec
+#include "_fenwick_impl.h"
+#undef TYPE
+#undef NAME
+#undef OP
+#undef IDENTITY
+#undef INVERSE
+#undef VEC
+
+#define TYPE int64_t
+#define NAME i64minsegtree
+#define OP(a, b) ((a) < (b) ? (a) : (b))
+#define IDENTITY INT64_MAX
+#define VEC i64vec
+#include "_segtree_impl.h"
+#undef TYPE
+#undef NAME
+#undef OP
+#undef IDENTITY
+#undef VEC
+
+#define TYPE int64_t
+#define NAME i64maxsegtree
+#define OP(a, b) ((a) > (b) ? (a) : (b))
+#define IDENTITY INT64_MIN
+#define VEC i64vec
+#include "_segtree_impl.h"
+#undef TYPE
+#undef NAME
+#undef OP
+#undef IDENTITY
+#undef VEC
+
+#define TYPE double
+#define NAME dminsegtree
+#define OP(a, b) ((a) < (b) ? (a) : (b))
+#define IDENTITY INFINITY
+#define VEC dvec
+#include "_segtree_impl.h"
+#undef TYPE
+#undef NAME
+#undef OP
+#undef IDENTITY
+#undef VEC
+
+#define TYPE double
+#define NAME dmaxsegtree
+#define OP(a, b) ((a) > (b) ? (a) : (b))
+#define IDENTITY -INFINITY
+#define VEC dvec
+#include "_segtree_impl.h"
+#undef TYPE
+#undef NAME
+#undef OP
+#undef IDENTITY
+#undef VEC
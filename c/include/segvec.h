@@ -0,0 +1,68 @@
+///
+/// Growable array that many threads can append to concurrently, without
+/// locks, while others read it.
+///
+/// Elements live in segments of power-of-two sizes that are allocated as
+/// needed and never reallocated, so unlike vec_t an element never moves and
+/// pointers to it stay valid until the segvec is freed.
+///
+/// Appenders reserve slots with a single atomic fetch-add, write their
+/// element, then publish it with its own ready flag, so no appender ever waits
+/// for another one. `size` is the length of the prefix of published elements.
+/// Appenders move it forward as their slots get ready: a stalled appender
+/// holds it back, without blocking the others or readers of later slots.
+///
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "vec.h"
+
+// Must be a power of two
+#define SEGVEC_FIRST_SEGMENT_SIZE 64
+#define SEGVEC_MAX_SEGMENTS 48
+
+typedef struct {
+    // Segment i holds SEGVEC_FIRST_SEGMENT_SIZE << i elements followed by
+    // one ready flag per element, NULL until the first append that needs it
+    _Atomic(uint8_t *) _segments[SEGVEC_MAX_SEGMENTS];
+    // Number of slots handed out to appenders
+    _Atomic size_t _reserved;
+    // All indices below are published and can be read without checking
+    // Indices above may be published too, see segvec_at
+    _Atomic size_t size;
+    size_t elsize;
+} segvec_t;
+
+/// Returns an empty segvec
+/// Always return a valid pointer. Panics in case of allocation error.
+segvec_t *segvec_new(size_t elsize);
+
+/// Not thread safe, all other threads must be done with the segvec
+void segvec_free(segvec_t *vec);
+
+/// O(1), thread safe, lock-free
+/// Appends a copy of the `elsize` bytes at `data`, and returns its index.
+/// The element is visible through segvec_at once it returns, `size` may still
+/// be lower while an earlier append isn't done.
+/// Panics in case of allocation error.
+size_t segvec_append(segvec_t *vec, const void *data);
+
+/// O(n), thread safe, lock-free
+/// Appends `n` contiguous elements with a single reservation, and returns the
+/// index of the first one. They stay contiguous in index, not in memory.
+/// Panics in case of allocation error.
+size_t segvec_append_many(segvec_t *vec, const void *data, size_t n);
+
+/// O(1), thread safe, wait-free
+/// Returns a pointer to the element, which never moves, or NULL if the index
+/// isn't published yet. Indices above `size` are checked one by one.
+void *segvec_at(const segvec_t *vec, size_t index);
+
+/// O(n), thread safe
+/// Copies the first `size` elements into a new plain vec
+/// Always return a valid pointer. Panics in case of allocation error.
+vec_t *segvec_to_vec(const segvec_t *vec);
@@ -0,0 +1,94 @@
+///
+/// Binary format to save vec_t and bitvec_t to files or sockets and load them
+/// back, without copying the data around.
+///
+/// A serialized container is a 32 bytes header followed by the raw payload,
+/// i.e. the exact bytes of the data field:
+///
+/// | offset | size | field                                                  |
+/// |--------|------|--------------------------------------------------------|
+/// | 0      | 4    | magic, "DSAV"                                          |
+/// | 4      | 1    | format version, 1                                      |
+/// | 5      | 1    | kind, 1 for vec_t, 2 for bitvec_t                      |
+/// | 6      | 1    | endianness of the payload, 1 little, 2 big             |
+/// | 7      | 1    | zero                                                   |
+/// | 8      | 4    | element size in bytes, 0 for bitvec_t                  |
+/// | 12     | 4    | CRC32C of the payload                                  |
+/// | 16     | 8    | number of elements                                     |
+/// | 24     | 8    | payload size in bytes                                  |
+///
+/// Header fields are always little endian. The payload is in the byte order
+/// of the machine that wrote it, it is converted when read on a machine of
+/// the other order, but can't be viewed there.
+///
+/// Writes are a single writev(2) of the header and the data field. Reads go
+/// straight into the data field of an existing container, or give a view of
+/// a buffer that holds a serialized container (e.g. a mmap-ed file).
+///
+/// All functions return 0 on success, or -1 with errno set:
+/// - EBADMSG if the input is not a valid serialized container of that kind,
+///   is truncated, or fails the checksum
+/// - EINVAL if the element size doesn't match, or a view would be misaligned
+/// - ENOTSUP if the payload can't be converted to this machine byte order
+/// - any error of read(2) or writev(2)
+///
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "_bitvec.h"
+#include "vec.h"
+
+#define SERIAL_HEADER_SIZE 32
+
+/// O(n)
+/// CRC32C (Castagnoli) of `n` bytes, continuing from `crc` (0 to start).
+/// Uses the SSE4.2 instruction when available.
+uint32_t serial_crc32c(uint32_t crc, const void *buff, size_t n);
+
+/// O(1)
+/// Number of bytes `vec_write` writes
+size_t vec_serialized_size(const vec_t *vec, uint8_t elsize);
+
+/// O(1)
+/// Number of bytes `bitvec_write` writes
+size_t bitvec_serialized_size(const bitvec_t *vec);
+
+/// O(n)
+/// Writes the header and data of `vec` to `fd`
+int vec_write(int fd, const vec_t *vec, uint8_t elsize);
+
+/// O(n)
+/// Writes the header and data of `vec` to `fd`
+int bitvec_write(int fd, const bitvec_t *vec);
+
+/// O(n)
+/// Reads a vec written by `vec_write` from `fd` into `vec`, replacing its
+/// content. The data is read in place, growing `vec` if needed.
+/// It grows as the data arrives, so a header announcing more than the input
+/// holds fails with EBADMSG instead of allocating it all.
+/// On error `vec` is left with a valid but unspecified content.
+/// Panics in case of allocation error.
+int vec_read(int fd, vec_t *vec, uint8_t elsize);
+
+/// O(n)
+/// Reads a bitvec written by `bitvec_write` from `fd` into `vec`, replacing
+/// its content. The data is read in place, growing `vec` if needed.
+/// It grows as the data arrives, so a header announcing more than the input
+/// holds fails with EBADMSG instead of allocating it all.
+/// On error `vec` is left with a valid but unspecified content.
+/// Panics in case of allocation error.
+int bitvec_read(int fd, bitvec_t *vec);
+
+/// O(n) to check the checksum, nothing is copied
+/// Fills `view` so that its data points into `buff`, which holds `len` bytes
+/// written by `vec_write`. The payload must be aligned for `elsize`.
+/// The view is only valid as long as `buff` is. Its capacity is 0 as it
+/// doesn't own its data, freeing or growing it panics.
+int vec_view(const void *buff, size_t len, uint8_t elsize, vec_t *view);
+
+/// O(n) to check the checksum, nothing is copied
+/// Same as `vec_view` for a bitvec written by `bitvec_write`
+int bitvec_view(const void *buff, size_t len, bitvec_t *view);
@@ -0,0 +1,82 @@
+///
+/// Arena of strings: many small strings packed one after the other in a
+/// single charvec, instead of one allocation each.
+///
+/// Strings are referred to by `str_t` handles, an offset and a length into
+/// the arena, which stay valid as the arena grows. Every string is followed
+/// by a NUL byte so it can be handed to C functions as is.
+///
+/// Strings can also be interned: interning a string that is already in the
+/// arena returns the handle of the first copy, so two interned handles are
+/// equal if and only if their offsets are, without looking at the bytes.
+///
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "vec.h"
+
+typedef struct {
+    // Offset of the first byte in the arena
+    uint32_t off;
+    // Number of bytes, without the trailing NUL
+    uint32_t len;
+} str_t;
+
+typedef struct {
+    uint32_t hash;
+    str_t str;
+} strarena_entry_t;
+
+typedef struct {
+    // Strings and their NUL terminators, back to back
+    charvec_t *buff;
+    // Open addressing table of interned strings, with linear probing
+    // Empty slots have an offset of UINT32_MAX
+    strarena_entry_t *_table;
+    // Power of two
+    size_t _table_cap;
+    // Number of distinct interned strings
+    size_t ninterned;
+} strarena_t;
+
+/// Returns an empty arena with room for `capacity` bytes of strings
+/// Always return a valid pointer. Panics in case of allocation error.
+strarena_t *strarena_new(size_t capacity);
+
+void strarena_free(strarena_t *arena);
+
+/// O(len) amortized
+/// Copies the `len` bytes of `s` at the end of the arena, even if the same
+/// string is already there
+/// Panics in case of allocation error, or if the arena exceeds 4 GiB
+str_t strarena_push(strarena_t *arena, const char *s, size_t len);
+
+/// O(len) on average
+/// Returns the handle of the interned copy of `s`, copying it into the arena
+/// first if it was never interned
+/// Panics in case of allocation error, or if the arena exceeds 4 GiB
+str_t strarena_intern(strarena_t *arena, const char *s, size_t len);
+
+/// O(len) on average
+/// Writes the handle of the interned copy of `s` in `res` and returns true if
+/// there is one, returns false otherwise
+bool strarena_find(const strarena_t *arena, const char *s, size_t len,
+                   str_t *res);
+
+/// O(1)
+/// Returns the NUL terminated string, valid until the arena grows
+const char *strarena_get(const strarena_t *arena, str_t str);
+
+/// O(1)
+/// Equality of two handles returned by `strarena_intern` on the same arena
+static inline bool str_interned_eq(str_t a, str_t b) {
+    return a.off == b.off;
+}
+
+/// O(len)
+/// Equality of the content of any two handles of the same arena
+bool strarena_eq(const strarena_t *arena, str_t a, str_t b);
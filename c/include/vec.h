@@ -40,6 +40,13 @@ void vec_free(vec_t *vec);
 /// the old vec->data pointer.
 void vec_append(vec_t *vec, uint8_t elsize, const void *data);
 
+/// O(n) if it needs to grow, O(1) otherwise
+/// Makes sure the vec can hold `capacity` elements without reallocating
+/// This potentially reallocates the data field, don't keep any reference to
+/// the old vec->data pointer.
+/// Panics in case of allocation error.
+void vec_reserve(vec_t *vec, uint8_t elsize, size_t capacity);
+
 /// O(1)
 /// Removes given index
 /// Panics if the index is out of bound
@@ -64,6 +71,32 @@ ssize_t vec_search_binary(const vec_t *vec, uint8_t elsize, const void *val,
 void vec_bubble_sort(const vec_t *vec, uint8_t elsize,
                      int (*cmp)(const void *, const void *));
 
+/// O(n)
+/// Sets `res` to a new bitvec where entry i is set when `expr` is true, `x`
+/// being vec->data[i] inside `expr`, e.g.
+/// `vec_bitvec_where(odd, vec, x, x % 2 != 0)` for the odd elements of vec
+/// Works with any typed vec. The condition is expanded inline into the same
+/// chunked loop as NAME_bitvec_<op>, so the compiler can vectorize it.
+/// Panics in case of allocation error.
+#define vec_bitvec_where(res, vec, x, expr)                                    \
+    do {                                                                       \
+        bool _where_chunk[256];                                                \
+        (res) = bitvec_new((vec)->size, 0);                                    \
+        for (size_t _where_i = 0; _where_i < (vec)->size;                      \
+             _where_i += sizeof(_where_chunk)) {                               \
+            size_t _where_n = (vec)->size - _where_i;                          \
+            if (_where_n > sizeof(_where_chunk)) {                             \
+                _where_n = sizeof(_where_chunk);                               \
+            }                                                                  \
+            for (size_t _where_j = 0; _where_j < _where_n; ++_where_j) {       \
+                __typeof__((vec)->data[0]) x =                                 \
+                    (vec)->data[_where_i + _where_j];                          \
+                _where_chunk[_where_j] = (expr);                               \
+            }                                                                  \
+            bitvec_pack((res), _where_i, _where_chunk, _where_n);              \
+        }                                                                      \
+    } while (0)
+
 #ifndef SKIP_VEC_IMPL
 
 /// Here are all the basic vector type
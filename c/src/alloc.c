@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "alloc.h"
+#include "instr.h"
 
 #define OOM_PANIC                                                              \
     {                                                                          \
@@ -13,6 +14,7 @@
     }
 
 void *malloc_or_panic(size_t size) {
+    INSTR_ADD(allocs, 1);
     void *p = malloc(size);
     if (p == NULL) {
         OOM_PANIC;
@@ -21,6 +23,7 @@ void *malloc_or_panic(size_t size) {
 }
 
 void *calloc_or_panic(size_t nmemb, size_t size) {
+    INSTR_ADD(allocs, 1);
     void *p = calloc(nmemb, size);
     if (p == NULL) {
         OOM_PANIC;
@@ -29,9 +32,20 @@ void *calloc_or_panic(size_t nmemb, size_t size) {
 }
 
 void *realloc_or_panic(void *ptr, size_t size) {
+    INSTR_ADD(reallocs, 1);
     void *p = realloc(ptr, size);
     if (p == NULL) {
         OOM_PANIC;
     }
     return p;
 }
+
+void *aligned_alloc_or_panic(size_t alignment, size_t size) {
+    INSTR_ADD(allocs, 1);
+    size = (size + alignment - 1) / alignment * alignment;
+    void *p = aligned_alloc(alignment, size ? size : alignment);
+    if (p == NULL) {
+        OOM_PANIC;
+    }
+    return p;
+}
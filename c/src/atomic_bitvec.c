@@ -0,0 +1,112 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "atomic_bitvec.h"
+#include "vec.h"
+
+static size_t _to_word_size(size_t size) {
+    return (size / 64) + (size % 64 != 0);
+}
+
+static void _check_bound(const atomic_bitvec_t *vec, size_t index) {
+    if (index >= vec->size) {
+        fprintf(stderr, "Out of bound access of index [%zu] on size %zu\n",
+                index, vec->size);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// Loads can't have release semantics
+static memory_order _load_order(memory_order order) {
+    switch (order) {
+    case memory_order_release:
+        return memory_order_relaxed;
+    case memory_order_acq_rel:
+        return memory_order_acquire;
+    default:
+        return order;
+    }
+}
+
+atomic_bitvec_t *atomic_bitvec_new(size_t size) {
+    atomic_bitvec_t *res = malloc_or_panic(sizeof(atomic_bitvec_t));
+
+    // At least one word so that _words is never NULL
+    size_t nwords = _to_word_size(size);
+    res->_words = calloc_or_panic(nwords ? nwords : 1, sizeof(uint64_t));
+    res->size = size;
+    return res;
+}
+
+void atomic_bitvec_free(atomic_bitvec_t *vec) {
+    free((void *)vec->_words);
+    free(vec);
+}
+
+bool atomic_bitvec_test_and_set(atomic_bitvec_t *vec, size_t index,
+                                memory_order order) {
+    _check_bound(vec, index);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    uint64_t old =
+        atomic_fetch_or_explicit(&vec->_words[index / 64], bit, order);
+    return old & bit;
+}
+
+bool atomic_bitvec_test_and_clear(atomic_bitvec_t *vec, size_t index,
+                                  memory_order order) {
+    _check_bound(vec, index);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    uint64_t old =
+        atomic_fetch_and_explicit(&vec->_words[index / 64], ~bit, order);
+    return old & bit;
+}
+
+bool atomic_bitvec_get(const atomic_bitvec_t *vec, size_t index,
+                       memory_order order) {
+    if (index >= vec->size) {
+        return false;
+    }
+    uint64_t word =
+        atomic_load_explicit(&vec->_words[index / 64], _load_order(order));
+    return (word >> (index % 64)) & 1;
+}
+
+size_t atomic_bitvec_set_many(atomic_bitvec_t *vec, const size_t *indices,
+                              size_t n, memory_order order) {
+    size_t newly_set = 0;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t word = indices[i] / 64;
+        uint64_t bits = 0;
+        for (; i < n && indices[i] / 64 == word; ++i) {
+            _check_bound(vec, indices[i]);
+            bits |= (uint64_t)1 << (indices[i] % 64);
+        }
+        uint64_t old =
+            atomic_fetch_or_explicit(&vec->_words[word], bits, order);
+        newly_set += __builtin_popcountll(bits & ~old);
+    }
+    return newly_set;
+}
+
+bitvec_t *atomic_bitvec_snapshot(const atomic_bitvec_t *vec,
+                                 memory_order order) {
+    bitvec_t *res = bitvec_new(vec->size, 0);
+    uint8_t *data = res->_data;
+    size_t nbytes = (vec->size / 8) + (vec->size % 8 != 0);
+
+    for (size_t w = 0; w < _to_word_size(vec->size); ++w) {
+        uint64_t word =
+            atomic_load_explicit(&vec->_words[w], _load_order(order));
+        // Byte by byte, so that it doesn't depend on endianness
+        for (size_t b = 0; b < 8 && w * 8 + b < nbytes; ++b) {
+            data[w * 8 + b] = (uint8_t)(word >> (b * 8));
+        }
+    }
+    return res;
+}
@@ -5,7 +5,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#    include <immintrin.h>
+#endif
+
 #include "alloc.h"
+#include "instr.h"
 #include "vec.h"
 
 static size_t _to_byte_size(size_t size) {
@@ -14,6 +19,11 @@ static size_t _to_byte_size(size_t size) {
 
 /// Allocate more size if needed to match newsize, appending zeros
 static void _increase_size(bitvec_t *vec, size_t newsize) {
+    // Views from serial.h have a capacity of 0, their data isn't theirs
+    if (vec->_cap == 0) {
+        fprintf(stderr, "Can't grow a view, it doesn't own its data\n");
+        exit(EXIT_FAILURE);
+    }
     size_t newcap = vec->_cap;
     while (newcap < newsize) {
         newcap *= 2;
@@ -49,14 +59,140 @@ bitvec_t *bitvec_new(size_t size, size_t capacity) {
 }
 
 bitvec_t *bitvec_from_buff(const bool *buff, size_t size) {
-    bitvec_t *res = bitvec_new(0, size);
-    for (size_t i = 0; i < size; ++i) {
-        bitvec_set(res, i, buff[i]);
-    }
-    res->size = size;
+    bitvec_t *res = bitvec_new(size, 0);
+    bitvec_pack(res, 0, buff, size);
     return res;
 }
 
+/// Packs `n` bytes (non-zero means 1) into `n / 8` bytes of bits
+/// `n` must be a multiple of 8
+static void _pack_bytes(uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i zero256 = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        uint32_t mask =
+            ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero256));
+        memcpy(dst + i / 8, &mask, sizeof(mask));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i zero128 = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        uint16_t mask =
+            ~(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero128));
+        memcpy(dst + i / 8, &mask, sizeof(mask));
+    }
+#endif
+    for (; i < n; i += 8) {
+        uint8_t byte = 0;
+        for (size_t j = 0; j < 8; ++j) {
+            byte |= (src[i + j] != 0) << j;
+        }
+        dst[i / 8] = byte;
+    }
+}
+
+/// Unpacks `nbytes` bytes of bits into `nbytes * 8` bytes, each set to `one`
+/// or 0
+static void _unpack_bytes(uint8_t *dst, const uint8_t *src, size_t nbytes,
+                          uint8_t one) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    // Broadcast 4 bytes of bits, spread byte k over lanes [8k; 8k+8[ and
+    // isolate one bit per lane
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, //
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bits = _mm256_set1_epi64x(0x8040201008040201);
+    const __m256i ones = _mm256_set1_epi8(one);
+    for (; i + 4 <= nbytes; i += 4) {
+        uint32_t word;
+        memcpy(&word, src + i, sizeof(word));
+        __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(word), spread);
+        v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bits), bits);
+        _mm256_storeu_si256((__m256i *)(dst + i * 8),
+                            _mm256_and_si256(v, ones));
+    }
+#endif
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; i < nbytes; ++i) {
+#    if defined(__BMI2__)
+        uint64_t spread = _pdep_u64(src[i], 0x0101010101010101);
+#    else
+        // Copy the byte in every lane, keep bit k in lane k, then turn any
+        // non-zero lane into 0x01
+        uint64_t spread =
+            ((uint64_t)src[i] * 0x0101010101010101) & 0x8040201008040201;
+        spread = ((spread + 0x7f7f7f7f7f7f7f7f) >> 7) & 0x0101010101010101;
+#    endif
+        spread *= one;
+        memcpy(dst + i * 8, &spread, sizeof(spread));
+    }
+#else
+    for (; i < nbytes; ++i) {
+        for (size_t j = 0; j < 8; ++j) {
+            dst[i * 8 + j] = (src[i] >> j) & 1 ? one : 0;
+        }
+    }
+#endif
+}
+
+void bitvec_pack(bitvec_t *vec, size_t index, const void *buff, size_t n) {
+    const uint8_t *src = buff;
+
+    if (n == 0) {
+        return;
+    }
+    if (index + n > vec->size) {
+        _increase_size(vec, index + n);
+    }
+    for (; n && index % 8; --n) {
+        bitvec_set(vec, index++, *src++ != 0);
+    }
+    size_t bulk = n - n % 8;
+    _pack_bytes((uint8_t *)vec->_data + index / 8, src, bulk);
+    index += bulk;
+    src += bulk;
+    n -= bulk;
+    for (; n; --n) {
+        bitvec_set(vec, index++, *src++ != 0);
+    }
+}
+
+static void _unpack(const bitvec_t *vec, size_t index, uint8_t *dst, size_t n,
+                    uint8_t one) {
+    size_t inbound = index < vec->size ? vec->size - index : 0;
+    if (inbound > n) {
+        inbound = n;
+    }
+    memset(dst + inbound, 0, n - inbound);
+    n = inbound;
+
+    for (; n && index % 8; --n) {
+        *dst++ = bitvec_get(vec, index++) ? one : 0;
+    }
+    size_t bulk = n - n % 8;
+    _unpack_bytes(dst, (const uint8_t *)vec->_data + index / 8, bulk / 8, one);
+    index += bulk;
+    dst += bulk;
+    n -= bulk;
+    for (; n; --n) {
+        *dst++ = bitvec_get(vec, index++) ? one : 0;
+    }
+}
+
+void bitvec_unpack(const bitvec_t *vec, size_t index, bool *buff, size_t n) {
+    _unpack(vec, index, (uint8_t *)buff, n, 1);
+}
+
+void bitvec_unpack_mask(const bitvec_t *vec, size_t index, uint8_t *buff,
+                        size_t n) {
+    _unpack(vec, index, buff, n, 0xff);
+}
+
 void bitvec_free(bitvec_t *vec) {
     vec_free((vec_t *)vec);
 }
@@ -122,6 +258,7 @@ void bitvec_print(const bitvec_t *vec) {
 
 ssize_t bitvec_search(const bitvec_t *vec, bool val) {
     for (size_t i = 0; i < vec->size; ++i) {
+        INSTR_ADD(probes, 1);
         if (bitvec_get(vec, i) == val) {
             return (ssize_t)i;
         }
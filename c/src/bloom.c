@@ -0,0 +1,344 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#    include <immintrin.h>
+#endif
+
+#include "alloc.h"
+#include "bloom.h"
+#include "vec.h"
+
+#define BLOCK_WORDS (BLOOM_BLOCK_BITS / 32)
+#define BLOCK_BYTES (BLOOM_BLOCK_BITS / 8)
+// Number of keys whose block is prefetched before probing in batch operations
+#define BATCH_SIZE 16
+
+static const char _magic[4] = {'B', 'L', 'M', '2'};
+static const size_t _header_size = 16;
+
+// Odd constants, word i of a block gets the bit given by the top 5 bits of
+// hash * _salts[i]
+static const uint32_t _salts[BLOCK_WORDS] = {
+    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b,
+    0x9efc4947, 0x5c6bfb31, 0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f,
+    0x165667b1, 0xd3a2646d, 0xfd7046c5, 0xb55a4f09,
+};
+
+// A key only sets a bit in k of the 16 words, the ones whose rank is below k
+// in a permutation of the words picked by hash * _select_salt: word i has
+// rank (i * odd + offset) % 16, odd and offset coming from the top 7 bits.
+// Every word is then used by about k/16 of the keys, instead of words k..15
+// never being used.
+static const uint32_t _select_salt = 0x2545f491;
+
+static uint32_t _select_offset(uint32_t hash) {
+    return (hash * _select_salt) >> 28;
+}
+
+static uint32_t _select_odd(uint32_t hash) {
+    return (((hash * _select_salt) >> 24) & 0xe) | 1;
+}
+
+static uint32_t *_block(const bloom_t *bloom, uint64_t hash) {
+    // Maps the hash to [0; nblocks[ without a division
+    size_t idx = ((unsigned __int128)hash * bloom->nblocks) >> 64;
+    return (uint32_t *)bloom->bits->_data + idx * BLOCK_WORDS;
+}
+
+#if defined(__AVX2__)
+
+static void _make_mask(uint32_t hash, uint8_t k, __m256i mask[2]) {
+    const __m256i hv = _mm256_set1_epi32(hash);
+    const __m256i kv = _mm256_set1_epi32(k);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i odd = _mm256_set1_epi32(_select_odd(hash));
+    const __m256i offset = _mm256_set1_epi32(_select_offset(hash));
+    const __m256i last = _mm256_set1_epi32(BLOCK_WORDS - 1);
+
+    for (int half = 0; half < 2; ++half) {
+        __m256i salts = _mm256_loadu_si256((const __m256i *)&_salts[half * 8]);
+        __m256i shift = _mm256_srli_epi32(_mm256_mullo_epi32(hv, salts), 27);
+        __m256i bits = _mm256_sllv_epi32(one, shift);
+        __m256i words = _mm256_add_epi32(lanes, _mm256_set1_epi32(half * 8));
+        __m256i rank = _mm256_and_si256(
+            _mm256_add_epi32(_mm256_mullo_epi32(words, odd), offset), last);
+        __m256i used = _mm256_cmpgt_epi32(kv, rank);
+        mask[half] = _mm256_and_si256(bits, used);
+    }
+}
+
+static void _insert_block(uint32_t *block, uint32_t hash, uint8_t k) {
+    __m256i mask[2];
+    _make_mask(hash, k, mask);
+    for (int half = 0; half < 2; ++half) {
+        __m256i *p = (__m256i *)block + half;
+        __m256i val = _mm256_or_si256(_mm256_load_si256(p), mask[half]);
+        _mm256_store_si256(p, val);
+    }
+}
+
+static bool _query_block(const uint32_t *block, uint32_t hash, uint8_t k) {
+    __m256i mask[2];
+    _make_mask(hash, k, mask);
+    const __m256i *p = (const __m256i *)block;
+    return _mm256_testc_si256(_mm256_load_si256(p), mask[0]) &&
+           _mm256_testc_si256(_mm256_load_si256(p + 1), mask[1]);
+}
+
+#else
+
+static void _make_mask(uint32_t hash, uint8_t k, uint32_t mask[BLOCK_WORDS]) {
+    uint32_t odd = _select_odd(hash);
+    uint32_t offset = _select_offset(hash);
+    for (uint32_t i = 0; i < BLOCK_WORDS; ++i) {
+        uint32_t bit = (uint32_t)1 << ((hash * _salts[i]) >> 27);
+        uint32_t rank = (i * odd + offset) % BLOCK_WORDS;
+        mask[i] = rank < k ? bit : 0;
+    }
+}
+
+static void _insert_block(uint32_t *block, uint32_t hash, uint8_t k) {
+    uint32_t mask[BLOCK_WORDS];
+    _make_mask(hash, k, mask);
+    for (int i = 0; i < BLOCK_WORDS; ++i) {
+        block[i] |= mask[i];
+    }
+}
+
+static bool _query_block(const uint32_t *block, uint32_t hash, uint8_t k) {
+    uint32_t mask[BLOCK_WORDS];
+    uint32_t missing = 0;
+    _make_mask(hash, k, mask);
+    for (int i = 0; i < BLOCK_WORDS; ++i) {
+        missing |= mask[i] & ~block[i];
+    }
+    return missing == 0;
+}
+
+#endif
+
+bloom_t *bloom_new(size_t nbits, uint8_t k) {
+    bloom_t *res = malloc_or_panic(sizeof(bloom_t));
+
+    res->nblocks = (nbits + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+    if (res->nblocks == 0) {
+        res->nblocks = 1;
+    }
+    if (k < 1) {
+        k = 1;
+    }
+    if (k > BLOOM_MAX_K) {
+        k = BLOOM_MAX_K;
+    }
+    res->k = k;
+
+    // Built by hand rather than with bitvec_new to get cache line alignment
+    size_t nbytes = res->nblocks * BLOCK_BYTES;
+    res->bits = malloc_or_panic(sizeof(bitvec_t));
+    res->bits->_data = aligned_alloc_or_panic(BLOCK_BYTES, nbytes);
+    memset(res->bits->_data, 0, nbytes);
+    res->bits->_cap = nbytes;
+    res->bits->size = nbytes * 8;
+    return res;
+}
+
+bloom_t *bloom_new_for(size_t n, double fpp) {
+    size_t nbits = bloom_nbits_for(n, fpp);
+    return bloom_new(nbits, bloom_k_for(nbits, n));
+}
+
+void bloom_free(bloom_t *bloom) {
+    bitvec_free(bloom->bits);
+    free(bloom);
+}
+
+/// Keys are spread over blocks following a Poisson distribution. Each key sets
+/// a given bit of its block with probability k/512 (its word is one of the k
+/// used with probability k/16, then the bit is one in 32), so a block holding
+/// j keys gives a false positive with probability (1 - (1 - k/512)^j)^k
+static double _blocked_fpp(size_t nblocks, uint8_t k, size_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    double lambda = (double)n / nblocks;
+    size_t hi = lambda + 10 * sqrt(lambda) + 20;
+    double res = 0;
+    for (size_t j = 0; j <= hi; ++j) {
+        double p = exp(j * log(lambda) - lambda - lgamma(j + 1.0));
+        res += p * pow(1 - pow(1 - (double)k / BLOOM_BLOCK_BITS, j), k);
+    }
+    return res;
+}
+
+size_t bloom_nbits_for(size_t n, double fpp) {
+    if (n == 0 || fpp >= 1) {
+        return BLOOM_BLOCK_BITS;
+    }
+    if (fpp < 1e-12) {
+        fpp = 1e-12;
+    }
+
+    // Start from the size of a classic Bloom filter, which is a lower bound,
+    // and grow until the blocked layout with its best k reaches the rate
+    size_t nbits = -(double)n * log(fpp) / (M_LN2 * M_LN2);
+    size_t nblocks = nbits / BLOOM_BLOCK_BITS + 1;
+    for (;;) {
+        nbits = nblocks * BLOOM_BLOCK_BITS;
+        if (_blocked_fpp(nblocks, bloom_k_for(nbits, n), n) <= fpp) {
+            return nbits;
+        }
+        nblocks += nblocks / 100 + 1;
+    }
+}
+
+uint8_t bloom_k_for(size_t nbits, size_t n) {
+    if (n == 0) {
+        return BLOOM_MAX_K;
+    }
+
+    // The classic round(ln 2 * m / n) is off for the blocked layout, try them
+    // all
+    size_t nblocks = (nbits + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+    if (nblocks == 0) {
+        nblocks = 1;
+    }
+    uint8_t best = 1;
+    double best_fpp = _blocked_fpp(nblocks, 1, n);
+    for (uint8_t k = 2; k <= BLOOM_MAX_K; ++k) {
+        double fpp = _blocked_fpp(nblocks, k, n);
+        if (fpp < best_fpp) {
+            best = k;
+            best_fpp = fpp;
+        }
+    }
+    return best;
+}
+
+double bloom_fpp(const bloom_t *bloom, size_t n) {
+    return _blocked_fpp(bloom->nblocks, bloom->k, n);
+}
+
+uint64_t bloom_hash(const void *key, size_t len) {
+    const uint8_t *bytes = key;
+    uint64_t h = 0x9e3779b97f4a7c15 ^ (len * 0xff51afd7ed558ccd);
+
+    for (; len >= 8; len -= 8, bytes += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, bytes, 8);
+        h = (h ^ chunk) * 0x9e3779b97f4a7c15;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; i < len; ++i) {
+        tail |= (uint64_t)bytes[i] << (i * 8);
+    }
+    h ^= tail;
+
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
+
+void bloom_insert(bloom_t *bloom, uint64_t hash) {
+    _insert_block(_block(bloom, hash), hash, bloom->k);
+}
+
+bool bloom_query(const bloom_t *bloom, uint64_t hash) {
+    return _query_block(_block(bloom, hash), hash, bloom->k);
+}
+
+void bloom_insert_many(bloom_t *bloom, const uint64_t *hashes, size_t n) {
+    uint32_t *blocks[BATCH_SIZE];
+
+    for (size_t i = 0; i < n; i += BATCH_SIZE) {
+        size_t batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+        for (size_t j = 0; j < batch; ++j) {
+            blocks[j] = _block(bloom, hashes[i + j]);
+            __builtin_prefetch(blocks[j], 1);
+        }
+        for (size_t j = 0; j < batch; ++j) {
+            _insert_block(blocks[j], hashes[i + j], bloom->k);
+        }
+    }
+}
+
+void bloom_query_many(const bloom_t *bloom, const uint64_t *hashes, size_t n,
+                      bool *out) {
+    const uint32_t *blocks[BATCH_SIZE];
+
+    for (size_t i = 0; i < n; i += BATCH_SIZE) {
+        size_t batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+        for (size_t j = 0; j < batch; ++j) {
+            blocks[j] = _block(bloom, hashes[i + j]);
+            __builtin_prefetch(blocks[j], 0);
+        }
+        for (size_t j = 0; j < batch; ++j) {
+            out[i + j] = _query_block(blocks[j], hashes[i + j], bloom->k);
+        }
+    }
+}
+
+static void _put_le(uint8_t *dst, uint64_t val, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; ++i) {
+        dst[i] = (uint8_t)(val >> (i * 8));
+    }
+}
+
+static uint64_t _get_le(const uint8_t *src, size_t nbytes) {
+    uint64_t res = 0;
+    for (size_t i = 0; i < nbytes; ++i) {
+        res |= (uint64_t)src[i] << (i * 8);
+    }
+    return res;
+}
+
+size_t bloom_serialized_size(const bloom_t *bloom) {
+    return _header_size + bloom->nblocks * BLOCK_BYTES;
+}
+
+// Layout: "BLM2", k, 3 zero bytes, nblocks as a little endian uint64, then
+// every 32-bit word of every block in little endian
+void bloom_serialize(const bloom_t *bloom, void *buff) {
+    uint8_t *dst = buff;
+    const uint32_t *words = bloom->bits->_data;
+
+    memcpy(dst, _magic, sizeof(_magic));
+    _put_le(dst + 4, bloom->k, 4);
+    _put_le(dst + 8, bloom->nblocks, 8);
+    dst += _header_size;
+    for (size_t i = 0; i < bloom->nblocks * BLOCK_WORDS; ++i) {
+        _put_le(dst + i * 4, words[i], 4);
+    }
+}
+
+bloom_t *bloom_deserialize(const void *buff, size_t len) {
+    const uint8_t *src = buff;
+
+    if (len < _header_size || memcmp(src, _magic, sizeof(_magic)) != 0) {
+        return NULL;
+    }
+    uint64_t k = _get_le(src + 4, 4);
+    uint64_t nblocks = _get_le(src + 8, 8);
+    if (k < 1 || k > BLOOM_MAX_K || nblocks == 0 ||
+        nblocks > (len - _header_size) / BLOCK_BYTES ||
+        len != _header_size + nblocks * BLOCK_BYTES) {
+        return NULL;
+    }
+
+    bloom_t *res = bloom_new(nblocks * BLOOM_BLOCK_BITS, k);
+    uint32_t *words = res->bits->_data;
+    src += _header_size;
+    for (size_t i = 0; i < nblocks * BLOCK_WORDS; ++i) {
+        words[i] = _get_le(src + i * 4, 4);
+    }
+    return res;
+}
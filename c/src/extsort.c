@@ -0,0 +1,415 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "extsort.h"
+
+// Smallest buffer a run gets during a merge. Below that, runs are merged in
+// several passes rather than reading them in tiny pieces
+#define MIN_MERGE_IO ((size_t)256 << 10)
+// For small budgets, the smallest buffer is this fraction of the budget
+#define MIN_MERGE_FAN_IN 16
+
+// A sorted run, stored in the temporary file between two offsets
+typedef struct {
+    off_t start;
+    off_t end;
+} _run_t;
+
+typedef struct {
+    int fd;
+    // Next offset to read, and end of the run
+    off_t off;
+    off_t end;
+    uint8_t *buff;
+    size_t cap;
+    size_t len;
+    size_t pos;
+} _reader_t;
+
+typedef struct {
+    int fd;
+    off_t off;
+    uint8_t *buff;
+    size_t cap;
+    size_t len;
+} _writer_t;
+
+static int _pread_full(int fd, void *buff, size_t n, off_t off) {
+    uint8_t *dst = buff;
+    while (n > 0) {
+        ssize_t got = pread(fd, dst, n, off);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            // The file shrank under our feet
+            errno = EIO;
+            return -1;
+        }
+        dst += got;
+        off += got;
+        n -= got;
+    }
+    return 0;
+}
+
+static int _pwrite_full(int fd, const void *buff, size_t n, off_t off) {
+    const uint8_t *src = buff;
+    while (n > 0) {
+        ssize_t put = pwrite(fd, src, n, off);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put < 0) {
+            return -1;
+        }
+        src += put;
+        off += put;
+        n -= put;
+    }
+    return 0;
+}
+
+static size_t _min(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static int _reader_fill(_reader_t *reader) {
+    size_t n = _min(reader->cap, reader->end - reader->off);
+    if (_pread_full(reader->fd, reader->buff, n, reader->off) < 0) {
+        return -1;
+    }
+    reader->off += n;
+    reader->len = n;
+    reader->pos = 0;
+
+    // Let the kernel fetch the next block while this one is merged
+    if (reader->off < reader->end) {
+        posix_fadvise(reader->fd, reader->off,
+                      _min(reader->cap, reader->end - reader->off),
+                      POSIX_FADV_WILLNEED);
+    }
+    return 0;
+}
+
+static int _writer_flush(_writer_t *writer) {
+    if (_pwrite_full(writer->fd, writer->buff, writer->len, writer->off) < 0) {
+        return -1;
+    }
+    writer->off += writer->len;
+    writer->len = 0;
+    return 0;
+}
+
+static int _writer_put(_writer_t *writer, const void *rec, size_t elsize) {
+    if (writer->len + elsize > writer->cap && _writer_flush(writer) < 0) {
+        return -1;
+    }
+    memcpy(writer->buff + writer->len, rec, elsize);
+    writer->len += elsize;
+    return 0;
+}
+
+typedef struct {
+    const extsort_config_t *config;
+    _reader_t *readers;
+    // tree[0] is the index of the smallest head, the other nodes hold the
+    // loser of the match played there. Leaf i is at node k + i
+    size_t *tree;
+    size_t k;
+} _loser_tree_t;
+
+// Exhausted runs lose against everything, ties go to the first run
+static bool _beats(const _loser_tree_t *lt, size_t a, size_t b) {
+    const _reader_t *ra = &lt->readers[a];
+    const _reader_t *rb = &lt->readers[b];
+    if (ra->pos == ra->len) {
+        return false;
+    }
+    if (rb->pos == rb->len) {
+        return true;
+    }
+    int res = lt->config->cmp(ra->buff + ra->pos, rb->buff + rb->pos);
+    return res < 0 || (res == 0 && a < b);
+}
+
+static void _loser_tree_build(_loser_tree_t *lt) {
+    size_t *winners = malloc_or_panic(2 * lt->k * sizeof(size_t));
+
+    for (size_t i = 0; i < lt->k; ++i) {
+        winners[lt->k + i] = i;
+    }
+    for (size_t node = lt->k - 1; node >= 1; --node) {
+        size_t left = winners[2 * node];
+        size_t right = winners[2 * node + 1];
+        bool left_wins = _beats(lt, left, right);
+        winners[node] = left_wins ? left : right;
+        lt->tree[node] = left_wins ? right : left;
+    }
+    lt->tree[0] = lt->k > 1 ? winners[1] : 0;
+    free(winners);
+}
+
+// O(log k), after the head of the winner changed
+static void _loser_tree_replay(_loser_tree_t *lt) {
+    size_t winner = lt->tree[0];
+    for (size_t node = (lt->k + winner) / 2; node >= 1; node /= 2) {
+        if (_beats(lt, lt->tree[node], winner)) {
+            size_t tmp = lt->tree[node];
+            lt->tree[node] = winner;
+            winner = tmp;
+        }
+    }
+    lt->tree[0] = winner;
+}
+
+/// Merges the `k` runs of `in_fd` into `out_fd` starting at `*out_off`, then
+/// moves `*out_off` past the written data
+static int _merge(const extsort_config_t *config, int in_fd,
+                  const _run_t *runs, size_t k, int out_fd, off_t *out_off,
+                  size_t budget) {
+    size_t elsize = config->elsize;
+    size_t io = budget / (k + 1) / elsize * elsize;
+    if (io < elsize) {
+        io = elsize;
+    }
+
+    _loser_tree_t lt = {
+        .config = config,
+        .readers = malloc_or_panic(k * sizeof(_reader_t)),
+        .tree = malloc_or_panic(k * sizeof(size_t)),
+        .k = k,
+    };
+    _writer_t writer = {
+        .fd = out_fd,
+        .off = *out_off,
+        .buff = malloc_or_panic(io),
+        .cap = io,
+        .len = 0,
+    };
+    int res = 0;
+
+    for (size_t i = 0; i < k; ++i) {
+        lt.readers[i] = (_reader_t){
+            .fd = in_fd,
+            .off = runs[i].start,
+            .end = runs[i].end,
+            .buff = malloc_or_panic(io),
+            .cap = io,
+            .len = 0,
+            .pos = 0,
+        };
+        if (res == 0) {
+            res = _reader_fill(&lt.readers[i]);
+        }
+    }
+
+    if (res == 0) {
+        _loser_tree_build(&lt);
+    }
+    while (res == 0) {
+        _reader_t *head = &lt.readers[lt.tree[0]];
+        if (head->pos == head->len) {
+            // The winner being exhausted means they all are
+            break;
+        }
+        res = _writer_put(&writer, head->buff + head->pos, elsize);
+        head->pos += elsize;
+        if (res == 0 && head->pos == head->len && head->off < head->end) {
+            res = _reader_fill(head);
+        }
+        _loser_tree_replay(&lt);
+    }
+    if (res == 0) {
+        res = _writer_flush(&writer);
+    }
+    *out_off = writer.off;
+
+    int saved_errno = errno;
+    for (size_t i = 0; i < k; ++i) {
+        free(lt.readers[i].buff);
+    }
+    free(lt.readers);
+    free(lt.tree);
+    free(writer.buff);
+    errno = saved_errno;
+    return res;
+}
+
+static int _open_tmp(const char *dir) {
+    if (dir == NULL) {
+        dir = getenv("TMPDIR");
+    }
+    if (dir == NULL || dir[0] == '\0') {
+        dir = "/tmp";
+    }
+
+    size_t len = strlen(dir) + sizeof("/extsort.XXXXXX");
+    char *path = malloc_or_panic(len);
+    snprintf(path, len, "%s/extsort.XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        // Nobody else needs to see it, and it goes away with the fd
+        unlink(path);
+    }
+    free(path);
+    return fd;
+}
+
+/// Sorts `size` bytes of `fd` chunk by chunk, and appends each chunk as a
+/// run to `tmp_fd`
+static int _make_runs(const extsort_config_t *config, int fd, off_t size,
+                      size_t chunk, int tmp_fd, _run_t *runs, size_t *nruns) {
+    uint8_t *buff = malloc_or_panic(chunk);
+    int res = 0;
+    off_t off = 0;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    for (*nruns = 0; off < size && res == 0; ++*nruns) {
+        size_t n = _min(chunk, size - off);
+        res = _pread_full(fd, buff, n, off);
+        if (res == 0) {
+            qsort(buff, n / config->elsize, config->elsize, config->cmp);
+            res = _pwrite_full(tmp_fd, buff, n, off);
+        }
+        runs[*nruns] = (_run_t){.start = off, .end = off + n};
+        off += n;
+    }
+
+    int saved_errno = errno;
+    free(buff);
+    errno = saved_errno;
+    return res;
+}
+
+static int _open_out(const char *path) {
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+/// Everything fits in the budget, no need for a temporary file
+static int _sort_in_memory(const extsort_config_t *config, int fd,
+                           size_t size, const char *out_path) {
+    uint8_t *buff = malloc_or_panic(size ? size : 1);
+    int res = _pread_full(fd, buff, size, 0);
+    int out_fd = -1;
+
+    if (res == 0) {
+        qsort(buff, size / config->elsize, config->elsize, config->cmp);
+        // Only opened now so that sorting a file in place works
+        out_fd = _open_out(out_path);
+        res = out_fd < 0 ? -1 : _pwrite_full(out_fd, buff, size, 0);
+    }
+
+    int saved_errno = errno;
+    if (out_fd >= 0 && close(out_fd) < 0 && res == 0) {
+        saved_errno = errno;
+        res = -1;
+    }
+    free(buff);
+    errno = saved_errno;
+    return res;
+}
+
+static int _sort_external(const extsort_config_t *config, int fd, off_t size,
+                          size_t budget, const char *out_path) {
+    size_t elsize = config->elsize;
+    size_t chunk = budget / elsize * elsize;
+    int tmp_fd = _open_tmp(config->tmpdir);
+    if (tmp_fd < 0) {
+        return -1;
+    }
+
+    // Each merge pass replaces at least two runs with one, so this is enough
+    // room for the runs of every pass
+    size_t nruns = (size + chunk - 1) / chunk;
+    _run_t *runs = malloc_or_panic(2 * nruns * sizeof(_run_t));
+    int res = _make_runs(config, fd, size, chunk, tmp_fd, runs, &nruns);
+
+    size_t min_io = _min(MIN_MERGE_IO, budget / MIN_MERGE_FAN_IN);
+    size_t fan_in = budget / (min_io > elsize ? min_io : elsize) - 1;
+    if (fan_in < 2) {
+        fan_in = 2;
+    }
+
+    // Merge the oldest runs together until one pass is enough
+    size_t first = 0;
+    off_t tmp_end = size;
+    while (res == 0 && nruns - first > fan_in) {
+        off_t start = tmp_end;
+        res = _merge(config, tmp_fd, runs + first, fan_in, tmp_fd, &tmp_end,
+                     budget);
+        runs[nruns++] = (_run_t){.start = start, .end = tmp_end};
+        first += fan_in;
+    }
+
+    int out_fd = -1;
+    if (res == 0) {
+        out_fd = _open_out(out_path);
+        res = out_fd < 0 ? -1 : 0;
+    }
+    if (res == 0) {
+        off_t out_off = 0;
+        posix_fadvise(tmp_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        res = _merge(config, tmp_fd, runs + first, nruns - first, out_fd,
+                     &out_off, budget);
+    }
+
+    int saved_errno = errno;
+    if (out_fd >= 0 && close(out_fd) < 0 && res == 0) {
+        saved_errno = errno;
+        res = -1;
+    }
+    close(tmp_fd);
+    free(runs);
+    errno = saved_errno;
+    return res;
+}
+
+int extsort_file(const char *in_path, const char *out_path,
+                 const extsort_config_t *config) {
+    if (config->elsize == 0 || config->cmp == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t budget = config->mem_budget ? config->mem_budget
+                                       : EXTSORT_DEFAULT_MEM_BUDGET;
+    // At least a chunk of two records, and a merge of two runs
+    if (budget < 3 * config->elsize) {
+        budget = 3 * config->elsize;
+    }
+
+    int fd = open(in_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    int res = fstat(fd, &st);
+    if (res == 0 && st.st_size % config->elsize != 0) {
+        errno = EINVAL;
+        res = -1;
+    }
+    if (res == 0) {
+        if ((size_t)st.st_size <= budget) {
+            res = _sort_in_memory(config, fd, st.st_size, out_path);
+        } else {
+            res = _sort_external(config, fd, st.st_size, budget, out_path);
+        }
+    }
+
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return res;
+}
@@ -0,0 +1,28 @@
+#include <string.h>
+
+#include "instr.h"
+
+#ifdef DSALGO_INSTRUMENT
+
+_Thread_local instr_counters_t _instr_counters;
+
+instr_counters_t instr_snapshot(void) {
+    return _instr_counters;
+}
+
+void instr_reset(void) {
+    memset(&_instr_counters, 0, sizeof(_instr_counters));
+}
+
+#else
+
+instr_counters_t instr_snapshot(void) {
+    instr_counters_t res;
+    memset(&res, 0, sizeof(res));
+    return res;
+}
+
+void instr_reset(void) {
+}
+
+#endif
@@ -2,11 +2,13 @@
 #include <stdlib.h>
 
 #include "alloc.h"
+#include "instr.h"
 #include "list32i.h"
 
 // segv if we go out of bounds
 // Could traverse from the tail if idx > size/2
 static node32i_t *_get_node(node32i_t *head, size_t idx) {
+    INSTR_ADD(node_hops, idx);
     for (size_t i = 0; i < idx; ++i) {
         head = head->next; // Kids, really, don't do linked list
     }
@@ -0,0 +1,211 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "instr.h"
+#include "pvec.h"
+#include "vec.h"
+
+#define FIRST_DIR_CAP 4
+
+static size_t _chunk_len(const pvec_t *vec) {
+    return (size_t)1 << vec->_chunk_shift;
+}
+
+static pvec_dir_t *_dir_new(size_t cap) {
+    pvec_dir_t *res =
+        malloc_or_panic(sizeof(pvec_dir_t) + cap * sizeof(pvec_chunk_t *));
+    atomic_init(&res->refs, 1);
+    res->nchunks = 0;
+    res->cap = cap;
+    return res;
+}
+
+/// Drops a reference, and frees the chunk if it was the last one
+static void _chunk_release(pvec_chunk_t *chunk) {
+    if (atomic_fetch_sub_explicit(&chunk->refs, 1, memory_order_acq_rel) ==
+        1) {
+        free(chunk);
+    }
+}
+
+static void _dir_release(pvec_dir_t *dir) {
+    if (atomic_fetch_sub_explicit(&dir->refs, 1, memory_order_acq_rel) == 1) {
+        for (size_t i = 0; i < dir->nchunks; ++i) {
+            _chunk_release(dir->chunks[i]);
+        }
+        free(dir);
+    }
+}
+
+/// Only this handle can see it, it can be written in place. The acquire
+/// pairs with the release of other handles dropping their reference, so that
+/// their reads are done before we write
+static bool _is_exclusive(_Atomic size_t *refs) {
+    return atomic_load_explicit(refs, memory_order_acquire) == 1;
+}
+
+/// Makes sure the directory belongs to this handle only and has room for
+/// `cap` chunks
+static pvec_dir_t *_own_dir(pvec_t *vec, size_t cap) {
+    pvec_dir_t *dir = vec->_dir;
+    bool exclusive = _is_exclusive(&dir->refs);
+
+    if (exclusive && dir->cap >= cap) {
+        return dir;
+    }
+    if (cap < dir->cap) {
+        cap = dir->cap;
+    }
+    if (exclusive) {
+        dir = realloc_or_panic(dir, sizeof(pvec_dir_t) +
+                                        cap * sizeof(pvec_chunk_t *));
+        dir->cap = cap;
+        vec->_dir = dir;
+        return dir;
+    }
+
+    // Shared with a snapshot: the copy references the same chunks
+    pvec_dir_t *res = _dir_new(cap);
+    res->nchunks = dir->nchunks;
+    for (size_t i = 0; i < dir->nchunks; ++i) {
+        res->chunks[i] = dir->chunks[i];
+        atomic_fetch_add_explicit(&res->chunks[i]->refs, 1,
+                                  memory_order_relaxed);
+    }
+    INSTR_ADD(bytes_copied, dir->nchunks * sizeof(pvec_chunk_t *));
+    _dir_release(dir);
+    vec->_dir = res;
+    return res;
+}
+
+/// Returns a chunk that only this handle can see, copying it if needed
+static pvec_chunk_t *_own_chunk(pvec_t *vec, size_t idx) {
+    pvec_dir_t *dir = _own_dir(vec, 0);
+    pvec_chunk_t *chunk = dir->chunks[idx];
+
+    if (_is_exclusive(&chunk->refs)) {
+        return chunk;
+    }
+    size_t nbytes = _chunk_len(vec) * vec->elsize;
+    pvec_chunk_t *res = malloc_or_panic(sizeof(pvec_chunk_t) + nbytes);
+    atomic_init(&res->refs, 1);
+    memcpy(res->data, chunk->data, nbytes);
+    INSTR_ADD(bytes_copied, nbytes);
+    _chunk_release(chunk);
+    dir->chunks[idx] = res;
+    return res;
+}
+
+static void _check_bound(const pvec_t *vec, size_t index) {
+    if (index >= vec->size) {
+        fprintf(stderr, "Out of bound access of index [%zu] on size %zu\n",
+                index, vec->size);
+        exit(EXIT_FAILURE);
+    }
+}
+
+pvec_t *pvec_new(size_t elsize) {
+    // The chunk length is the largest power of two fitting in
+    // PVEC_CHUNK_BYTES, which zero-size elements don't have
+    if (elsize == 0) {
+        fprintf(stderr, "pvec elements can't be zero-size\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pvec_t *res = malloc_or_panic(sizeof(pvec_t));
+    res->_dir = _dir_new(FIRST_DIR_CAP);
+    res->size = 0;
+    res->elsize = elsize;
+    res->_chunk_shift = 0;
+    while (((size_t)2 << res->_chunk_shift) * elsize <= PVEC_CHUNK_BYTES) {
+        ++res->_chunk_shift;
+    }
+    return res;
+}
+
+pvec_t *pvec_from_vec(const vec_t *vec, uint8_t elsize) {
+    pvec_t *res = pvec_new(elsize);
+    size_t chunk_len = _chunk_len(res);
+    size_t nchunks = (vec->size + chunk_len - 1) / chunk_len;
+    pvec_dir_t *dir = _own_dir(res, nchunks);
+
+    for (size_t i = 0; i < nchunks; ++i) {
+        size_t nbytes = chunk_len * elsize;
+        size_t used = (vec->size - i * chunk_len) * elsize;
+        dir->chunks[i] = malloc_or_panic(sizeof(pvec_chunk_t) + nbytes);
+        atomic_init(&dir->chunks[i]->refs, 1);
+        memcpy(dir->chunks[i]->data, vec->data + i * chunk_len * elsize,
+               used < nbytes ? used : nbytes);
+    }
+    INSTR_ADD(bytes_copied, vec->size * elsize);
+    dir->nchunks = nchunks;
+    res->size = vec->size;
+    return res;
+}
+
+void pvec_free(pvec_t *vec) {
+    _dir_release(vec->_dir);
+    free(vec);
+}
+
+pvec_t *pvec_snapshot(const pvec_t *vec) {
+    pvec_t *res = malloc_or_panic(sizeof(pvec_t));
+    *res = *vec;
+    atomic_fetch_add_explicit(&vec->_dir->refs, 1, memory_order_relaxed);
+    return res;
+}
+
+const void *pvec_at(const pvec_t *vec, size_t index) {
+    _check_bound(vec, index);
+    const pvec_chunk_t *chunk = vec->_dir->chunks[index >> vec->_chunk_shift];
+    return &chunk->data[(index & (_chunk_len(vec) - 1)) * vec->elsize];
+}
+
+void pvec_set(pvec_t *vec, size_t index, const void *data) {
+    _check_bound(vec, index);
+    pvec_chunk_t *chunk = _own_chunk(vec, index >> vec->_chunk_shift);
+    memcpy(&chunk->data[(index & (_chunk_len(vec) - 1)) * vec->elsize], data,
+           vec->elsize);
+}
+
+void pvec_append(pvec_t *vec, const void *data) {
+    size_t idx = vec->size >> vec->_chunk_shift;
+    size_t offset = vec->size & (_chunk_len(vec) - 1);
+    pvec_chunk_t *chunk;
+
+    if (idx == vec->_dir->nchunks) {
+        pvec_dir_t *dir = vec->_dir;
+        dir = _own_dir(vec, dir->nchunks < dir->cap ? 0 : 2 * dir->cap);
+        chunk = malloc_or_panic(sizeof(pvec_chunk_t) +
+                                _chunk_len(vec) * vec->elsize);
+        atomic_init(&chunk->refs, 1);
+        dir->chunks[dir->nchunks++] = chunk;
+    } else {
+        // A snapshot may share the last chunk, even though it doesn't see
+        // the slot we're writing to, as it could append there too
+        chunk = _own_chunk(vec, idx);
+    }
+    memcpy(&chunk->data[offset * vec->elsize], data, vec->elsize);
+    INSTR_ADD(bytes_copied, vec->elsize);
+    ++vec->size;
+}
+
+vec_t *pvec_to_vec(const pvec_t *vec) {
+    vec_t *res = vec_new(vec->elsize, vec->size, vec->size);
+    size_t chunk_bytes = _chunk_len(vec) * vec->elsize;
+    size_t total = vec->size * vec->elsize;
+
+    for (size_t i = 0; i * chunk_bytes < total; ++i) {
+        size_t n = total - i * chunk_bytes;
+        memcpy(res->data + i * chunk_bytes, vec->_dir->chunks[i]->data,
+               n < chunk_bytes ? n : chunk_bytes);
+    }
+    INSTR_ADD(bytes_copied, total);
+    return res;
+}
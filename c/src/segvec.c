@@ -0,0 +1,194 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "segvec.h"
+#include "vec.h"
+
+typedef struct {
+    size_t segment;
+    size_t offset;
+} position_t;
+
+static size_t _segment_size(size_t segment) {
+    return (size_t)SEGVEC_FIRST_SEGMENT_SIZE << segment;
+}
+
+/// Segment i starts at index FIRST * (2^i - 1), so shifting the index by
+/// FIRST gives a number whose highest bit is the segment
+static position_t _position(size_t index) {
+    size_t shifted = index + SEGVEC_FIRST_SEGMENT_SIZE;
+    size_t msb = 63 - __builtin_clzll(shifted);
+    size_t first_msb = __builtin_ctzll(SEGVEC_FIRST_SEGMENT_SIZE);
+    position_t res = {msb - first_msb, shifted - ((size_t)1 << msb)};
+    return res;
+}
+
+/// A segment holds its elements, followed by one ready flag per element
+static _Atomic uint8_t *_ready_flags(const segvec_t *vec, uint8_t *data,
+                                     size_t segment) {
+    return (_Atomic uint8_t *)(data + _segment_size(segment) * vec->elsize);
+}
+
+/// Returns the segment, allocating it if no other thread did it already
+static uint8_t *_get_or_alloc_segment(segvec_t *vec, size_t segment) {
+    if (segment >= SEGVEC_MAX_SEGMENTS) {
+        fprintf(stderr, "segvec is full\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint8_t *res =
+        atomic_load_explicit(&vec->_segments[segment], memory_order_acquire);
+    if (res != NULL) {
+        return res;
+    }
+    size_t count = _segment_size(segment);
+    uint8_t *fresh = malloc_or_panic(count * vec->elsize + count);
+    _Atomic uint8_t *flags = _ready_flags(vec, fresh, segment);
+    for (size_t i = 0; i < count; ++i) {
+        atomic_init(&flags[i], 0);
+    }
+    if (atomic_compare_exchange_strong_explicit(
+            &vec->_segments[segment], &res, fresh, memory_order_acq_rel,
+            memory_order_acquire)) {
+        return fresh;
+    }
+    // Someone else won the race, res now holds their segment
+    free(fresh);
+    return res;
+}
+
+/// Whether the element was written and published
+/// seq_cst pairs with the store in `_publish`: of two appenders publishing
+/// neighbour slots, at least one sees the other's flag when extending `size`
+static bool _is_ready(const segvec_t *vec, size_t index) {
+    position_t pos = _position(index);
+    if (pos.segment >= SEGVEC_MAX_SEGMENTS) {
+        return false;
+    }
+    uint8_t *segment = atomic_load_explicit(&vec->_segments[pos.segment],
+                                            memory_order_acquire);
+    return segment != NULL &&
+           atomic_load_explicit(
+               &_ready_flags(vec, segment, pos.segment)[pos.offset],
+               memory_order_seq_cst);
+}
+
+/// Moves `size` past every ready slot following it
+/// Never waits: if the next slot isn't ready, its appender will do it
+static void _extend_size(segvec_t *vec) {
+    size_t size = atomic_load_explicit(&vec->size, memory_order_seq_cst);
+    for (;;) {
+        size_t end = size;
+        while (_is_ready(vec, end)) {
+            ++end;
+        }
+        if (end == size ||
+            atomic_compare_exchange_weak_explicit(&vec->size, &size, end,
+                                                  memory_order_seq_cst,
+                                                  memory_order_seq_cst)) {
+            return;
+        }
+        // Someone else moved it, size now holds their value
+    }
+}
+
+/// Marks [first; first + n[ as ready, then helps extending the prefix
+static void _publish(segvec_t *vec, size_t first, size_t n) {
+    size_t index = first;
+    while (index < first + n) {
+        position_t pos = _position(index);
+        uint8_t *segment = atomic_load_explicit(&vec->_segments[pos.segment],
+                                                memory_order_relaxed);
+        _Atomic uint8_t *flags = _ready_flags(vec, segment, pos.segment);
+        size_t count = _segment_size(pos.segment) - pos.offset;
+        if (count > first + n - index) {
+            count = first + n - index;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            atomic_store_explicit(&flags[pos.offset + i], 1,
+                                  memory_order_seq_cst);
+        }
+        index += count;
+    }
+    _extend_size(vec);
+}
+
+segvec_t *segvec_new(size_t elsize) {
+    segvec_t *res = malloc_or_panic(sizeof(segvec_t));
+
+    for (size_t i = 0; i < SEGVEC_MAX_SEGMENTS; ++i) {
+        atomic_init(&res->_segments[i], NULL);
+    }
+    atomic_init(&res->_reserved, 0);
+    atomic_init(&res->size, 0);
+    res->elsize = elsize;
+    return res;
+}
+
+void segvec_free(segvec_t *vec) {
+    for (size_t i = 0; i < SEGVEC_MAX_SEGMENTS; ++i) {
+        free(atomic_load_explicit(&vec->_segments[i], memory_order_relaxed));
+    }
+    free(vec);
+}
+
+size_t segvec_append(segvec_t *vec, const void *data) {
+    return segvec_append_many(vec, data, 1);
+}
+
+size_t segvec_append_many(segvec_t *vec, const void *data, size_t n) {
+    const uint8_t *src = data;
+    size_t first =
+        atomic_fetch_add_explicit(&vec->_reserved, n, memory_order_relaxed);
+
+    size_t index = first;
+    size_t remaining = n;
+    while (remaining) {
+        position_t pos = _position(index);
+        uint8_t *segment = _get_or_alloc_segment(vec, pos.segment);
+        size_t count = _segment_size(pos.segment) - pos.offset;
+        if (count > remaining) {
+            count = remaining;
+        }
+        memcpy(segment + pos.offset * vec->elsize, src, count * vec->elsize);
+        src += count * vec->elsize;
+        index += count;
+        remaining -= count;
+    }
+
+    _publish(vec, first, n);
+    return first;
+}
+
+void *segvec_at(const segvec_t *vec, size_t index) {
+    if (index >= atomic_load_explicit(&vec->size, memory_order_acquire) &&
+        !_is_ready(vec, index)) {
+        return NULL;
+    }
+    position_t pos = _position(index);
+    uint8_t *segment = atomic_load_explicit(&vec->_segments[pos.segment],
+                                            memory_order_relaxed);
+    return segment + pos.offset * vec->elsize;
+}
+
+vec_t *segvec_to_vec(const segvec_t *vec) {
+    size_t size = atomic_load_explicit(&vec->size, memory_order_acquire);
+    vec_t *res = vec_new(vec->elsize, size, size);
+
+    size_t index = 0;
+    for (size_t i = 0; index < size; ++i) {
+        size_t count = _segment_size(i);
+        if (count > size - index) {
+            count = size - index;
+        }
+        uint8_t *segment =
+            atomic_load_explicit(&vec->_segments[i], memory_order_relaxed);
+        memcpy(res->data + index * vec->elsize, segment, count * vec->elsize);
+        index += count;
+    }
+    return res;
+}
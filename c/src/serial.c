@@ -0,0 +1,458 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__SSE4_2__)
+#    include <nmmintrin.h>
+#endif
+
+#include "_bitvec.h"
+#include "alloc.h"
+#include "serial.h"
+#include "vec.h"
+
+#define VERSION 1
+#define KIND_VEC 1
+#define KIND_BITVEC 2
+#define ENDIAN_LITTLE 1
+#define ENDIAN_BIG 2
+
+// When the input size isn't known, payloads are read in steps of at least
+// this many bytes, growing the container as data actually arrives
+#define READ_STEP (1 << 20)
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#    define ENDIAN_NATIVE ENDIAN_BIG
+#else
+#    define ENDIAN_NATIVE ENDIAN_LITTLE
+#endif
+
+static const char _magic[4] = {'D', 'S', 'A', 'V'};
+
+typedef struct {
+    uint8_t kind;
+    uint8_t endianness;
+    uint32_t elsize;
+    uint32_t crc;
+    uint64_t count;
+    uint64_t nbytes;
+} header_t;
+
+#if !defined(__SSE4_2__)
+
+static uint32_t _crc_table[256];
+static pthread_once_t _crc_table_once = PTHREAD_ONCE_INIT;
+
+static void _crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+        }
+        _crc_table[i] = crc;
+    }
+}
+
+#endif
+
+uint32_t serial_crc32c(uint32_t crc, const void *buff, size_t n) {
+    const uint8_t *src = buff;
+    crc = ~crc;
+
+#if defined(__SSE4_2__)
+    for (; n >= 8; n -= 8, src += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, src, 8);
+        crc = _mm_crc32_u64(crc, chunk);
+    }
+    for (; n > 0; --n, ++src) {
+        crc = _mm_crc32_u8(crc, *src);
+    }
+#else
+    pthread_once(&_crc_table_once, _crc_table_init);
+    for (; n > 0; --n, ++src) {
+        crc = (crc >> 8) ^ _crc_table[(crc ^ *src) & 0xff];
+    }
+#endif
+    return ~crc;
+}
+
+static void _put_le(uint8_t *dst, uint64_t val, size_t nbytes) {
+    for (size_t i = 0; i < nbytes; ++i) {
+        dst[i] = (uint8_t)(val >> (i * 8));
+    }
+}
+
+static uint64_t _get_le(const uint8_t *src, size_t nbytes) {
+    uint64_t res = 0;
+    for (size_t i = 0; i < nbytes; ++i) {
+        res |= (uint64_t)src[i] << (i * 8);
+    }
+    return res;
+}
+
+static void _encode_header(const header_t *header,
+                           uint8_t dst[SERIAL_HEADER_SIZE]) {
+    memset(dst, 0, SERIAL_HEADER_SIZE);
+    memcpy(dst, _magic, sizeof(_magic));
+    dst[4] = VERSION;
+    dst[5] = header->kind;
+    dst[6] = header->endianness;
+    _put_le(dst + 8, header->elsize, 4);
+    _put_le(dst + 12, header->crc, 4);
+    _put_le(dst + 16, header->count, 8);
+    _put_le(dst + 24, header->nbytes, 8);
+}
+
+static int _decode_header(const uint8_t *src, uint8_t kind,
+                          header_t *header) {
+    if (memcmp(src, _magic, sizeof(_magic)) != 0 || src[4] != VERSION ||
+        src[5] != kind || src[7] != 0 ||
+        (src[6] != ENDIAN_LITTLE && src[6] != ENDIAN_BIG)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    header->kind = kind;
+    header->endianness = src[6];
+    header->elsize = _get_le(src + 8, 4);
+    header->crc = _get_le(src + 12, 4);
+    header->count = _get_le(src + 16, 8);
+    header->nbytes = _get_le(src + 24, 8);
+
+    // The payload size must follow from the count, without overflowing
+    bool consistent;
+    if (kind == KIND_VEC) {
+        consistent = header->elsize != 0 &&
+                     header->count <= UINT64_MAX / header->elsize &&
+                     header->nbytes == header->count * header->elsize;
+    } else {
+        uint64_t nbytes = header->count / 8 + (header->count % 8 != 0);
+        consistent = header->elsize == 0 && header->nbytes == nbytes;
+    }
+    if (!consistent || header->nbytes > SIZE_MAX) {
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
+
+static int _writev_full(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t put = writev(fd, iov, iovcnt);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put < 0) {
+            return -1;
+        }
+        // Partial write, skip what went through and try again
+        while (iovcnt > 0 && (size_t)put >= iov->iov_len) {
+            put -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + put;
+            iov->iov_len -= put;
+        }
+    }
+    return 0;
+}
+
+static int _read_full(int fd, void *buff, size_t n) {
+    uint8_t *dst = buff;
+    while (n > 0) {
+        ssize_t got = read(fd, dst, n);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+        dst += got;
+        n -= got;
+    }
+    return 0;
+}
+
+/// Returns how many bytes of the payload to read before the next check: all
+/// of them if `fd` is a regular file, which must then hold at least `nbytes`
+/// more bytes, otherwise READ_STEP.
+/// This way a header announcing more than the input holds fails with EBADMSG
+/// before allocating it all.
+static int _first_step(int fd, uint64_t nbytes, size_t *step) {
+    struct stat st;
+    off_t offset;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        (offset = lseek(fd, 0, SEEK_CUR)) < 0) {
+        *step = READ_STEP;
+        return 0;
+    }
+    if (offset > st.st_size || nbytes > (uint64_t)(st.st_size - offset)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    *step = nbytes;
+    return 0;
+}
+
+/// End of the next step of a payload read, from `done` out of `total`
+/// Steps double, so the container grows geometrically with the input.
+static size_t _next_step(size_t done, size_t total, size_t min_step) {
+    size_t step = done > min_step ? done : min_step;
+    return total - done < step ? total : done + step;
+}
+
+static int _write(int fd, const header_t *header, const void *payload) {
+    uint8_t encoded[SERIAL_HEADER_SIZE];
+    _encode_header(header, encoded);
+    struct iovec iov[2] = {
+        {.iov_base = encoded, .iov_len = SERIAL_HEADER_SIZE},
+        {.iov_base = (void *)payload, .iov_len = header->nbytes},
+    };
+    return _writev_full(fd, iov, header->nbytes ? 2 : 1);
+}
+
+/// Converts the payload to the native byte order
+static int _swap_payload(uint8_t *data, size_t count, size_t elsize) {
+    for (size_t i = 0; i < count; ++i, data += elsize) {
+        switch (elsize) {
+        case 1:
+            return 0;
+        case 2: {
+            uint16_t val;
+            memcpy(&val, data, 2);
+            val = __builtin_bswap16(val);
+            memcpy(data, &val, 2);
+            break;
+        }
+        case 4: {
+            uint32_t val;
+            memcpy(&val, data, 4);
+            val = __builtin_bswap32(val);
+            memcpy(data, &val, 4);
+            break;
+        }
+        case 8: {
+            uint64_t val;
+            memcpy(&val, data, 8);
+            val = __builtin_bswap64(val);
+            memcpy(data, &val, 8);
+            break;
+        }
+        default:
+            // We don't know what the element is made of
+            errno = ENOTSUP;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/// Extra bits of the last byte of a bitvec must be zero
+static bool _padding_ok(const uint8_t *data, uint64_t count) {
+    return count % 8 == 0 || (data[count / 8] >> (count % 8)) == 0;
+}
+
+size_t vec_serialized_size(const vec_t *vec, uint8_t elsize) {
+    return SERIAL_HEADER_SIZE + vec->size * elsize;
+}
+
+size_t bitvec_serialized_size(const bitvec_t *vec) {
+    return SERIAL_HEADER_SIZE + vec->size / 8 + (vec->size % 8 != 0);
+}
+
+int vec_write(int fd, const vec_t *vec, uint8_t elsize) {
+    header_t header = {
+        .kind = KIND_VEC,
+        .endianness = ENDIAN_NATIVE,
+        .elsize = elsize,
+        .crc = serial_crc32c(0, vec->data, vec->size * elsize),
+        .count = vec->size,
+        .nbytes = vec->size * elsize,
+    };
+    return _write(fd, &header, vec->data);
+}
+
+int bitvec_write(int fd, const bitvec_t *vec) {
+    size_t nbytes = bitvec_serialized_size(vec) - SERIAL_HEADER_SIZE;
+    header_t header = {
+        .kind = KIND_BITVEC,
+        // A bitmap is a sequence of bytes, it has no byte order
+        .endianness = ENDIAN_NATIVE,
+        .elsize = 0,
+        .crc = serial_crc32c(0, vec->_data, nbytes),
+        .count = vec->size,
+        .nbytes = nbytes,
+    };
+    return _write(fd, &header, vec->_data);
+}
+
+int vec_read(int fd, vec_t *vec, uint8_t elsize) {
+    uint8_t encoded[SERIAL_HEADER_SIZE];
+    header_t header;
+
+    if (_read_full(fd, encoded, SERIAL_HEADER_SIZE) < 0 ||
+        _decode_header(encoded, KIND_VEC, &header) < 0) {
+        return -1;
+    }
+    if (header.elsize != elsize) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t step;
+    if (_first_step(fd, header.nbytes, &step) < 0) {
+        return -1;
+    }
+    vec->size = 0;
+    for (size_t done = 0; done < header.count;) {
+        size_t end = _next_step(done, header.count, step / elsize + 1);
+        vec_reserve(vec, elsize, end);
+        if (_read_full(fd, vec->data + done * elsize, (end - done) * elsize) <
+            0) {
+            return -1;
+        }
+        done = end;
+    }
+    if (serial_crc32c(0, vec->data, header.nbytes) != header.crc) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (header.endianness != ENDIAN_NATIVE &&
+        _swap_payload(vec->data, header.count, elsize) < 0) {
+        return -1;
+    }
+    vec->size = header.count;
+    return 0;
+}
+
+/// Allocated but unused bits of a bitvec must be zero, so that growing it
+/// later doesn't bring back old bits
+static void _clear_bits(bitvec_t *vec) {
+    memset(vec->_data, 0, vec->_cap);
+}
+
+int bitvec_read(int fd, bitvec_t *vec) {
+    uint8_t encoded[SERIAL_HEADER_SIZE];
+    header_t header;
+
+    if (_read_full(fd, encoded, SERIAL_HEADER_SIZE) < 0 ||
+        _decode_header(encoded, KIND_BITVEC, &header) < 0) {
+        return -1;
+    }
+
+    size_t step;
+    if (_first_step(fd, header.nbytes, &step) < 0) {
+        return -1;
+    }
+    vec->size = 0;
+    for (size_t done = 0; done < header.nbytes;) {
+        size_t end = _next_step(done, header.nbytes, step);
+        if (vec->_cap < end) {
+            if (vec->_cap == 0) {
+                // A view, see bitvec_view
+                fprintf(stderr,
+                        "Can't grow a view, it doesn't own its data\n");
+                exit(EXIT_FAILURE);
+            }
+            vec->_data = realloc_or_panic(vec->_data, end);
+            vec->_cap = end;
+        }
+        if (_read_full(fd, (uint8_t *)vec->_data + done, end - done) < 0) {
+            _clear_bits(vec);
+            return -1;
+        }
+        done = end;
+    }
+    if (serial_crc32c(0, vec->_data, header.nbytes) != header.crc ||
+        !_padding_ok(vec->_data, header.count)) {
+        _clear_bits(vec);
+        errno = EBADMSG;
+        return -1;
+    }
+    // Bytes past the payload still hold the previous content
+    memset((uint8_t *)vec->_data + header.nbytes, 0,
+           vec->_cap - header.nbytes);
+    vec->size = header.count;
+    return 0;
+}
+
+/// Checks the header and checksum of a serialized container held in memory
+static int _view(const void *buff, size_t len, uint8_t kind,
+                 header_t *header) {
+    if (len < SERIAL_HEADER_SIZE) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (_decode_header(buff, kind, header) < 0) {
+        return -1;
+    }
+    const uint8_t *payload = (const uint8_t *)buff + SERIAL_HEADER_SIZE;
+    if (header->nbytes != len - SERIAL_HEADER_SIZE ||
+        serial_crc32c(0, payload, header->nbytes) != header->crc) {
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
+
+int vec_view(const void *buff, size_t len, uint8_t elsize, vec_t *view) {
+    header_t header;
+
+    if (_view(buff, len, KIND_VEC, &header) < 0) {
+        return -1;
+    }
+    if (header.elsize != elsize) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (header.endianness != ENDIAN_NATIVE && elsize > 1) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    // Power of two sizes need their natural alignment, up to 16
+    uint8_t *payload = (uint8_t *)buff + SERIAL_HEADER_SIZE;
+    size_t align = elsize & (elsize - 1) ? 1 : elsize > 16 ? 16 : elsize;
+    if ((uintptr_t)payload % align != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    view->data = payload;
+    view->size = header.count;
+    // Not ours to reallocate, see _check_owned in vec.c
+    view->_cap = 0;
+    return 0;
+}
+
+int bitvec_view(const void *buff, size_t len, bitvec_t *view) {
+    header_t header;
+    uint8_t *payload = (uint8_t *)buff + SERIAL_HEADER_SIZE;
+
+    if (_view(buff, len, KIND_BITVEC, &header) < 0) {
+        return -1;
+    }
+    if (!_padding_ok(payload, header.count)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    view->_data = payload;
+    view->size = header.count;
+    // Not ours to reallocate, growing it panics
+    view->_cap = 0;
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "instr.h"
+#include "strarena.h"
+#include "vec.h"
+
+#define FIRST_TABLE_CAP 16
+#define EMPTY UINT32_MAX
+
+/// FNV-1a, strings interned in symbol tables are short
+static uint32_t _hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static strarena_entry_t *_table_new(size_t cap) {
+    strarena_entry_t *res = malloc_or_panic(cap * sizeof(strarena_entry_t));
+    for (size_t i = 0; i < cap; ++i) {
+        res[i].str.off = EMPTY;
+    }
+    return res;
+}
+
+/// Reinserts all entries into a table twice as big, reusing their hashes
+static void _table_grow(strarena_t *arena) {
+    size_t cap = arena->_table_cap * 2;
+    strarena_entry_t *table = _table_new(cap);
+
+    for (size_t i = 0; i < arena->_table_cap; ++i) {
+        strarena_entry_t entry = arena->_table[i];
+        if (entry.str.off == EMPTY) {
+            continue;
+        }
+        size_t slot = entry.hash & (cap - 1);
+        while (table[slot].str.off != EMPTY) {
+            slot = (slot + 1) & (cap - 1);
+        }
+        table[slot] = entry;
+    }
+    free(arena->_table);
+    arena->_table = table;
+    arena->_table_cap = cap;
+}
+
+/// Returns the slot holding `s`, or the empty slot where it would go
+static size_t _table_slot(const strarena_t *arena, const char *s, size_t len,
+                          uint32_t hash) {
+    size_t mask = arena->_table_cap - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        strarena_entry_t entry = arena->_table[slot];
+        INSTR_ADD(probes, 1);
+        if (entry.str.off == EMPTY) {
+            return slot;
+        }
+        if (entry.hash == hash && entry.str.len == len &&
+            memcmp(arena->buff->data + entry.str.off, s, len) == 0) {
+            return slot;
+        }
+    }
+}
+
+strarena_t *strarena_new(size_t capacity) {
+    strarena_t *res = malloc_or_panic(sizeof(strarena_t));
+    res->buff = charvec_new(0, capacity);
+    res->_table = _table_new(FIRST_TABLE_CAP);
+    res->_table_cap = FIRST_TABLE_CAP;
+    res->ninterned = 0;
+    return res;
+}
+
+void strarena_free(strarena_t *arena) {
+    charvec_free(arena->buff);
+    free(arena->_table);
+    free(arena);
+}
+
+str_t strarena_push(strarena_t *arena, const char *s, size_t len) {
+    charvec_t *buff = arena->buff;
+    // The last offset must stay below EMPTY
+    if (len >= EMPTY - buff->size) {
+        fprintf(stderr, "String arena is full\n");
+        exit(EXIT_FAILURE);
+    }
+    if (buff->size + len + 1 > buff->_cap) {
+        // `s` may be a string of the arena, which is about to move
+        bool inside = s >= buff->data && s < buff->data + buff->size;
+        size_t inside_off = inside ? (size_t)(s - buff->data) : 0;
+        size_t needed = buff->size + len + 1;
+        charvec_reserve(buff, 2 * buff->_cap > needed ? 2 * buff->_cap
+                                                      : needed);
+        if (inside) {
+            s = buff->data + inside_off;
+        }
+    }
+
+    str_t res = {.off = buff->size, .len = len};
+    memcpy(buff->data + buff->size, s, len);
+    buff->data[buff->size + len] = '\0';
+    INSTR_ADD(bytes_copied, len + 1);
+    buff->size += len + 1;
+    return res;
+}
+
+str_t strarena_intern(strarena_t *arena, const char *s, size_t len) {
+    uint32_t hash = _hash(s, len);
+    size_t slot = _table_slot(arena, s, len, hash);
+    if (arena->_table[slot].str.off != EMPTY) {
+        return arena->_table[slot].str;
+    }
+
+    str_t res = strarena_push(arena, s, len);
+    arena->_table[slot] = (strarena_entry_t){.hash = hash, .str = res};
+    ++arena->ninterned;
+    // Keep the load factor under 1/2 so that probe sequences stay short
+    if (arena->ninterned * 2 > arena->_table_cap) {
+        _table_grow(arena);
+    }
+    return res;
+}
+
+bool strarena_find(const strarena_t *arena, const char *s, size_t len,
+                   str_t *res) {
+    size_t slot = _table_slot(arena, s, len, _hash(s, len));
+    if (arena->_table[slot].str.off == EMPTY) {
+        return false;
+    }
+    *res = arena->_table[slot].str;
+    return true;
+}
+
+const char *strarena_get(const strarena_t *arena, str_t str) {
+    return arena->buff->data + str.off;
+}
+
+bool strarena_eq(const strarena_t *arena, str_t a, str_t b) {
+    return a.len == b.len &&
+           (a.off == b.off || memcmp(arena->buff->data + a.off,
+                                     arena->buff->data + b.off, a.len) == 0);
+}
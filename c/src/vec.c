@@ -6,12 +6,22 @@
 #include <sys/types.h>
 
 #include "alloc.h"
+#include "instr.h"
 #include "vec.h"
 
 uint8_t *ptrat(const vec_t *vec, uint8_t elsize, size_t idx) {
     return &vec->data[idx * elsize];
 }
 
+/// Views from serial.h have a capacity of 0, as their data isn't theirs to
+/// reallocate or free. Owned vecs always have room for at least 8 elements.
+static void _check_owned(const vec_t *vec, const char *action) {
+    if (vec->_cap == 0) {
+        fprintf(stderr, "Can't %s a view, it doesn't own its data\n", action);
+        exit(EXIT_FAILURE);
+    }
+}
+
 vec_t *vec_new(size_t elsize, size_t size, size_t capacity) {
     vec_t *res = malloc_or_panic(sizeof(vec_t));
 
@@ -31,25 +41,38 @@ vec_t *vec_new(size_t elsize, size_t size, size_t capacity) {
 vec_t *vec_from_buff(const void *buff, size_t elsize, size_t size) {
     vec_t *res = vec_new(elsize, 0, size);
     memcpy(res->data, buff, size * elsize);
+    INSTR_ADD(bytes_copied, size * elsize);
     res->size = size;
     return res;
 }
 
 void vec_free(vec_t *vec) {
+    _check_owned(vec, "free");
     free(vec->data);
     free(vec);
 }
 
 void vec_append(vec_t *vec, uint8_t elsize, const void *data) {
-    if (vec->size == vec->_cap) {
+    if (vec->size >= vec->_cap) {
+        _check_owned(vec, "grow");
         vec->_cap *= 2;
         vec->data = realloc_or_panic(vec->data, vec->_cap * elsize);
     }
 
     memcpy(ptrat(vec, elsize, vec->size), data, elsize);
+    INSTR_ADD(bytes_copied, elsize);
     ++vec->size;
 }
 
+void vec_reserve(vec_t *vec, uint8_t elsize, size_t capacity) {
+    if (capacity <= vec->_cap) {
+        return;
+    }
+    _check_owned(vec, "grow");
+    vec->data = realloc_or_panic(vec->data, capacity * elsize);
+    vec->_cap = capacity;
+}
+
 void vec_remove(vec_t *vec, uint8_t elsize, size_t index) {
     if (vec->size < index) {
         fprintf(stderr, "Out of bound removal of index [%zu] on size %zu\n",
@@ -59,6 +82,7 @@ void vec_remove(vec_t *vec, uint8_t elsize, size_t index) {
     for (size_t i = index * elsize; i < vec->size * elsize; ++i) {
         ((uint8_t *)vec->data)[i] = ((uint8_t *)vec->data)[i + elsize];
     }
+    INSTR_ADD(bytes_copied, (vec->size - index) * elsize);
     vec->size -= 1;
 }
 
@@ -86,6 +110,7 @@ void vec_print(const vec_t *vec, uint8_t elsize) {
 
 ssize_t vec_search(const vec_t *vec, uint8_t elsize, const void *val) {
     for (size_t i = 0; i < vec->size; ++i) {
+        INSTR_ADD(probes, 1);
         if (memcmp(ptrat(vec, elsize, i), val, elsize) == 0) {
             return (ssize_t)i;
         }
@@ -100,6 +125,7 @@ ssize_t vec_search_binary(const vec_t *vec, uint8_t elsize, const void *val,
 
     while (lo < hi) {
         size_t mid = (lo + hi) / 2;
+        INSTR_ADD(probes, 1);
         int c = cmp(ptrat(vec, elsize, mid), val);
         if (c == 0) {
             return mid;
@@ -117,7 +143,9 @@ void vec_bubble_sort(const vec_t *vec, uint8_t elsize,
     void *tmp = malloc_or_panic(elsize);
     for (size_t i = 0; i < vec->size; ++i) {
         for (size_t j = 0; j < vec->size - i - 1; ++j) {
+            INSTR_ADD(probes, 1);
             if (cmp(ptrat(vec, elsize, j), ptrat(vec, elsize, j + 1)) > 0) {
+                INSTR_ADD(bytes_copied, 3 * elsize);
                 memcpy(tmp, ptrat(vec, elsize, j), elsize);
                 memcpy(ptrat(vec, elsize, j), ptrat(vec, elsize, j + 1),
                        elsize);
@@ -1,10 +1,23 @@
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <string.h>
 
 #include "_bitvec.h"
+#include "atomic_bitvec.h"
+#include "bloom.h"
+#include "extsort.h"
+#include "instr.h"
 #include "list32i.h"
+#include "pvec.h"
+#include "rangequery.h"
+#include "segvec.h"
+#include "serial.h"
+#include "strarena.h"
 #include "vec.h"
 
 #define FAIL                                                                   \
@@ -513,8 +526,1065 @@ int test_bitvec_two_crystal_balls() {
     return 0;
 }
 
+int test_bitvec_pack() {
+    bool buff[300];
+    bool out[310];
+    for (size_t i = 0; i < 300; ++i) {
+        buff[i] = (i * 7) % 3 == 0 || i % 11 == 0;
+    }
+
+    for (size_t offset = 0; offset < 20; ++offset) {
+        for (size_t n = 0; n < 300 - offset; n += 37) {
+            bitvec_t *vec = bitvec_new(0, 0);
+            bitvec_pack(vec, offset, buff + offset, n);
+            if (vec->size != (n ? offset + n : 0)) {
+                FAIL;
+            }
+            for (size_t i = 0; i < vec->size; ++i) {
+                if (bitvec_get(vec, i) != (i >= offset && buff[i])) {
+                    FAIL;
+                }
+            }
+
+            bitvec_unpack(vec, offset, out, n + 10);
+            for (size_t i = 0; i < n + 10; ++i) {
+                if (out[i] != (i < n && buff[offset + i])) {
+                    FAIL;
+                }
+            }
+            bitvec_free(vec);
+        }
+    }
+
+    {
+        uint8_t mask[] = {0xff, 0, 0, 0xff, 0xff, 0, 0xff, 0, 0, 0, 0xff};
+        uint8_t out_mask[sizeof(mask)];
+        bitvec_t *vec = bitvec_new(0, 0);
+        bitvec_pack(vec, 0, mask, sizeof(mask));
+        bitvec_t *answer = bitvec_from({true, false, false, true, true, false,
+                                        true, false, false, false, true});
+        if (!bitvec_eq(vec, answer)) {
+            bitvec_print(vec);
+            FAIL;
+        }
+        bitvec_unpack_mask(vec, 0, out_mask, sizeof(mask));
+        if (memcmp(mask, out_mask, sizeof(mask)) != 0) {
+            FAIL;
+        }
+        bitvec_free(vec);
+        bitvec_free(answer);
+    }
+
+    return 0;
+}
+
+bool is_odd_int32(const void *ptr) {
+    return *(int32_t *)ptr % 2 != 0;
+}
+
+int test_i32vec_bitvec_predicates() {
+    i32vec_t *vec = i32vec_from({5, -3, 8, 0, 12, 7, 3, 3, 9, -1});
+
+    {
+        bitvec_t *res = i32vec_bitvec_gt(vec, 3);
+        bitvec_t *answer = bitvec_from(
+            {true, false, true, false, true, true, false, false, true, false});
+        if (!bitvec_eq(res, answer)) {
+            bitvec_print(res);
+            FAIL;
+        }
+        bitvec_free(res);
+        bitvec_free(answer);
+    }
+    {
+        bitvec_t *res = i32vec_bitvec_eq(vec, 3);
+        bitvec_t *answer = bitvec_from({false, false, false, false, false,
+                                        false, true, true, false, false});
+        if (!bitvec_eq(res, answer)) {
+            FAIL;
+        }
+        bitvec_free(res);
+        bitvec_free(answer);
+    }
+    {
+        bitvec_t *res = i32vec_bitvec_from_predicate(vec, is_odd_int32);
+        bitvec_t *answer = bitvec_from(
+            {true, true, false, false, false, true, true, true, true, true});
+        if (!bitvec_eq(res, answer)) {
+            FAIL;
+        }
+        bitvec_free(res);
+        bitvec_free(answer);
+    }
+    {
+        bitvec_t *res;
+        vec_bitvec_where(res, vec, x, x % 2 != 0);
+        bitvec_t *answer = bitvec_from(
+            {true, true, false, false, false, true, true, true, true, true});
+        if (!bitvec_eq(res, answer)) {
+            FAIL;
+        }
+        bitvec_free(res);
+        bitvec_free(answer);
+    }
+
+    i32vec_t *big = i32vec_new(1000, 0);
+    for (size_t i = 0; i < big->size; ++i) {
+        big->data[i] = (int32_t)(i * 37 % 101);
+    }
+    bitvec_t *res = i32vec_bitvec_le(big, 50);
+    if (res->size != big->size) {
+        FAIL;
+    }
+    for (size_t i = 0; i < big->size; ++i) {
+        if (bitvec_get(res, i) != (big->data[i] <= 50)) {
+            FAIL;
+        }
+    }
+    bitvec_free(res);
+    i32vec_free(big);
+
+    i32vec_free(vec);
+    return 0;
+}
+
+#define ATOMIC_BITVEC_THREADS 4
+#define ATOMIC_BITVEC_SIZE 100000
+
+void *atomic_bitvec_visit_all(void *arg) {
+    atomic_bitvec_t *vec = ((void **)arg)[0];
+    _Atomic size_t *visited = ((void **)arg)[1];
+    for (size_t i = 0; i < ATOMIC_BITVEC_SIZE; ++i) {
+        if (!atomic_bitvec_test_and_set(vec, i, memory_order_relaxed)) {
+            atomic_fetch_add(visited, 1);
+        }
+    }
+    return NULL;
+}
+
+int test_atomic_bitvec() {
+    {
+        atomic_bitvec_t *vec = atomic_bitvec_new(130);
+        if (atomic_bitvec_test_and_set(vec, 3, memory_order_relaxed)) {
+            FAIL;
+        }
+        if (!atomic_bitvec_test_and_set(vec, 3, memory_order_relaxed)) {
+            FAIL;
+        }
+        if (!atomic_bitvec_get(vec, 3, memory_order_acquire)) {
+            FAIL;
+        }
+        if (atomic_bitvec_get(vec, 4, memory_order_acquire)) {
+            FAIL;
+        }
+        if (!atomic_bitvec_test_and_clear(vec, 3, memory_order_acq_rel)) {
+            FAIL;
+        }
+        if (atomic_bitvec_test_and_clear(vec, 3, memory_order_acq_rel)) {
+            FAIL;
+        }
+
+        size_t indices[] = {0, 2, 2, 63, 64, 65, 129, 1, 0};
+        if (atomic_bitvec_set_many(vec, indices, 9, memory_order_relaxed) !=
+            7) {
+            FAIL;
+        }
+
+        bitvec_t *snapshot = atomic_bitvec_snapshot(vec, memory_order_acquire);
+        bitvec_t *answer = bitvec_new(130, 0);
+        bitvec_set(answer, 0, true);
+        bitvec_set(answer, 1, true);
+        bitvec_set(answer, 2, true);
+        bitvec_set(answer, 63, true);
+        bitvec_set(answer, 64, true);
+        bitvec_set(answer, 65, true);
+        bitvec_set(answer, 129, true);
+        if (!bitvec_eq(snapshot, answer)) {
+            bitvec_print(snapshot);
+            FAIL;
+        }
+        bitvec_free(snapshot);
+        bitvec_free(answer);
+        atomic_bitvec_free(vec);
+    }
+    {
+        atomic_bitvec_t *vec = atomic_bitvec_new(ATOMIC_BITVEC_SIZE);
+        _Atomic size_t visited = 0;
+        void *arg[] = {vec, &visited};
+        pthread_t threads[ATOMIC_BITVEC_THREADS];
+
+        for (int i = 0; i < ATOMIC_BITVEC_THREADS; ++i) {
+            pthread_create(&threads[i], NULL, atomic_bitvec_visit_all, arg);
+        }
+        for (int i = 0; i < ATOMIC_BITVEC_THREADS; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        // Every entry must have been claimed by exactly one thread
+        if (visited != ATOMIC_BITVEC_SIZE) {
+            printf("visited %zu\n", (size_t)visited);
+            FAIL;
+        }
+        atomic_bitvec_free(vec);
+    }
+    return 0;
+}
+
+int test_bloom() {
+    const size_t n = 10000;
+    bloom_t *bloom = bloom_new_for(n, 0.01);
+    uint64_t *hashes = malloc(2 * n * sizeof(uint64_t));
+    bool *found = malloc(2 * n * sizeof(bool));
+
+    if (bloom_fpp(bloom, n) > 0.01) {
+        FAIL;
+    }
+    // Within about 5% of the 9.6 bits per key of a classic filter
+    if (bloom_nbits_for(1000000, 0.01) > 10100000) {
+        FAIL;
+    }
+    for (size_t i = 0; i < 2 * n; ++i) {
+        hashes[i] = bloom_hash(&i, sizeof(i));
+    }
+    bloom_insert_many(bloom, hashes, n / 2);
+    for (size_t i = n / 2; i < n; ++i) {
+        bloom_insert(bloom, hashes[i]);
+    }
+
+    // No false negatives, and about the expected rate of false positives
+    bloom_query_many(bloom, hashes, 2 * n, found);
+    size_t false_positives = 0;
+    for (size_t i = 0; i < 2 * n; ++i) {
+        if (found[i] != bloom_query(bloom, hashes[i])) {
+            FAIL;
+        }
+        if (i < n && !found[i]) {
+            FAIL;
+        }
+        false_positives += i >= n && found[i];
+    }
+    if (false_positives > n / 50) {
+        printf("%zu false positives\n", false_positives);
+        FAIL;
+    }
+
+    size_t len = bloom_serialized_size(bloom);
+    uint8_t *buff = malloc(len);
+    bloom_serialize(bloom, buff);
+    if (bloom_deserialize(buff, len - 1) != NULL) {
+        FAIL;
+    }
+    bloom_t *copy = bloom_deserialize(buff, len);
+    if (copy == NULL || copy->k != bloom->k ||
+        !bitvec_eq(copy->bits, bloom->bits)) {
+        FAIL;
+    }
+
+    bloom_free(copy);
+    free(buff);
+    free(found);
+    free(hashes);
+    bloom_free(bloom);
+    return 0;
+}
+
+int test_instr() {
+    instr_reset();
+
+    i32vec_t *vec = i32vec_new(0, 0);
+    for (int i = 0; i < 100; ++i) {
+        i32vec_append(vec, i);
+    }
+    i32vec_remove(vec, 0);
+    i32vec_search(vec, 10);
+    i32vec_free(vec);
+
+    list32i_t *list = list32i_new();
+    list32i_push_back(list, 1);
+    list32i_push_back(list, 2);
+    list32i_push_back(list, 3);
+    list32i_get_idx(list, 2);
+    list32i_pop_front(list);
+    list32i_pop_front(list);
+    list32i_pop_front(list);
+    list32i_free(list);
+
+    instr_counters_t counters = instr_snapshot();
+#ifdef DSALGO_INSTRUMENT
+    // vec_new + calloc of the data, then one per list node
+    if (counters.allocs != 5) {
+        printf("allocs %" PRIu64 "\n", counters.allocs);
+        FAIL;
+    }
+    // Capacity 8 -> 16 -> 32 -> 64 -> 128
+    if (counters.reallocs != 4) {
+        printf("reallocs %" PRIu64 "\n", counters.reallocs);
+        FAIL;
+    }
+    // 100 appends, then 100 elements shifted by the removal
+    if (counters.bytes_copied != 800) {
+        printf("bytes_copied %" PRIu64 "\n", counters.bytes_copied);
+        FAIL;
+    }
+    if (counters.probes != 10) {
+        printf("probes %" PRIu64 "\n", counters.probes);
+        FAIL;
+    }
+    if (counters.node_hops != 2) {
+        printf("node_hops %" PRIu64 "\n", counters.node_hops);
+        FAIL;
+    }
+#else
+    instr_counters_t zero;
+    memset(&zero, 0, sizeof(zero));
+    if (memcmp(&counters, &zero, sizeof(zero)) != 0) {
+        FAIL;
+    }
+#endif
+
+    instr_reset();
+    counters = instr_snapshot();
+    if (counters.allocs != 0 || counters.bytes_copied != 0) {
+        FAIL;
+    }
+    return 0;
+}
+
+#define SEGVEC_THREADS 4
+#define SEGVEC_PER_THREAD 20000
+
+void *segvec_append_all(void *arg) {
+    segvec_t *vec = ((void **)arg)[0];
+    uint64_t thread = (uintptr_t)((void **)arg)[1];
+    for (uint64_t i = 0; i < SEGVEC_PER_THREAD; ++i) {
+        uint64_t val = thread << 32 | i;
+        segvec_append(vec, &val);
+    }
+    return NULL;
+}
+
+int test_segvec() {
+    {
+        segvec_t *vec = segvec_new(sizeof(int32_t));
+        if (segvec_at(vec, 0) != NULL) {
+            FAIL;
+        }
+        int32_t val = 42;
+        if (segvec_append(vec, &val) != 0) {
+            FAIL;
+        }
+        int32_t *first = segvec_at(vec, 0);
+        if (first == NULL || *first != 42) {
+            FAIL;
+        }
+
+        int32_t buff[1000];
+        for (int32_t i = 0; i < 1000; ++i) {
+            buff[i] = i;
+        }
+        if (segvec_append_many(vec, buff, 1000) != 1) {
+            FAIL;
+        }
+        // Elements never move
+        if (segvec_at(vec, 0) != first || vec->size != 1001) {
+            FAIL;
+        }
+        for (int32_t i = 0; i < 1000; ++i) {
+            if (*(int32_t *)segvec_at(vec, i + 1) != i) {
+                FAIL;
+            }
+        }
+        if (segvec_at(vec, 1001) != NULL) {
+            FAIL;
+        }
+
+        i32vec_t *snapshot = (i32vec_t *)segvec_to_vec(vec);
+        if (snapshot->size != 1001 || snapshot->data[0] != 42 ||
+            memcmp(&snapshot->data[1], buff, sizeof(buff)) != 0) {
+            FAIL;
+        }
+        i32vec_free(snapshot);
+        segvec_free(vec);
+    }
+    {
+        // An appender stalled between its reservation and its publication
+        // holds `size` back, but doesn't block later appends nor reads
+        segvec_t *vec = segvec_new(sizeof(int32_t));
+        atomic_fetch_add(&vec->_reserved, 1);
+        int32_t val = 7;
+        if (segvec_append(vec, &val) != 1) {
+            FAIL;
+        }
+        int32_t *second = segvec_at(vec, 1);
+        if (second == NULL || *second != 7 || segvec_at(vec, 0) != NULL ||
+            vec->size != 0) {
+            FAIL;
+        }
+        vec_t *snapshot = segvec_to_vec(vec);
+        if (snapshot->size != 0) {
+            FAIL;
+        }
+        vec_free(snapshot);
+        segvec_free(vec);
+    }
+    {
+        segvec_t *vec = segvec_new(sizeof(uint64_t));
+        pthread_t threads[SEGVEC_THREADS];
+        void *args[SEGVEC_THREADS][2];
+
+        for (uintptr_t i = 0; i < SEGVEC_THREADS; ++i) {
+            args[i][0] = vec;
+            args[i][1] = (void *)i;
+            pthread_create(&threads[i], NULL, segvec_append_all, args[i]);
+        }
+        for (int i = 0; i < SEGVEC_THREADS; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        if (vec->size != SEGVEC_THREADS * SEGVEC_PER_THREAD) {
+            FAIL;
+        }
+
+        // Every value is there once, in the order its thread appended it
+        uint64_t next[SEGVEC_THREADS] = {0};
+        for (size_t i = 0; i < vec->size; ++i) {
+            uint64_t val = *(uint64_t *)segvec_at(vec, i);
+            uint64_t thread = val >> 32;
+            if (thread >= SEGVEC_THREADS ||
+                (val & 0xffffffff) != next[thread]) {
+                FAIL;
+            }
+            ++next[thread];
+        }
+        segvec_free(vec);
+    }
+    return 0;
+}
+
 // -------------------------------------------
 
+// Sorted set of the values of [0; universe[ kept with probability
+// permille / 1000
+u32vec_t *random_u32_set(uint32_t universe, int permille) {
+    u32vec_t *res = u32vec_new(0, 0);
+    for (uint32_t i = 0; i < universe; ++i) {
+        if (rand() % 1000 < permille) {
+            u32vec_append(res, i);
+        }
+    }
+    return res;
+}
+
+// Checks `res` against the membership of each value in `a` and `b`
+bool check_u32_set_op(const u32vec_t *a, const u32vec_t *b,
+                      const u32vec_t *res, uint32_t universe, char op) {
+    bool *in_a = calloc(universe, sizeof(bool));
+    bool *in_b = calloc(universe, sizeof(bool));
+    for (size_t i = 0; i < a->size; ++i) {
+        in_a[a->data[i]] = true;
+    }
+    for (size_t i = 0; i < b->size; ++i) {
+        in_b[b->data[i]] = true;
+    }
+    size_t k = 0;
+    bool ok = true;
+    for (uint32_t v = 0; v < universe && ok; ++v) {
+        bool want = op == '&'   ? in_a[v] && in_b[v]
+                    : op == '|' ? in_a[v] || in_b[v]
+                                : in_a[v] && !in_b[v];
+        if (want) {
+            ok = k < res->size && res->data[k++] == v;
+        }
+    }
+    free(in_a);
+    free(in_b);
+    return ok && k == res->size;
+}
+
+int test_u32vec_set_ops() {
+    // Permille of kept values, covering both the merge and galloping paths
+    const int densities[][2] = {
+        {500, 500}, {900, 100}, {1000, 1000}, {1000, 0},
+        {990, 5},   {5, 990},   {300, 20},    {0, 0},
+    };
+    const uint32_t universe = 5000;
+    srand(42);
+
+    for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); ++d) {
+        u32vec_t *a = random_u32_set(universe, densities[d][0]);
+        u32vec_t *b = random_u32_set(universe, densities[d][1]);
+        u32vec_t *out = u32vec_new(0, 0);
+
+        u32vec_intersect(a, b, out);
+        if (!check_u32_set_op(a, b, out, universe, '&')) {
+            FAIL;
+        }
+        u32vec_union(a, b, out);
+        if (!check_u32_set_op(a, b, out, universe, '|')) {
+            FAIL;
+        }
+        u32vec_difference(a, b, out);
+        if (!check_u32_set_op(a, b, out, universe, '-')) {
+            FAIL;
+        }
+        u32vec_difference(b, a, out);
+        if (!check_u32_set_op(b, a, out, universe, '-')) {
+            FAIL;
+        }
+
+        // In place, the output being one of the inputs
+        u32vec_t *copy = u32vec_from_buff(a->data, a->size);
+        u32vec_intersect(copy, b, copy);
+        if (!check_u32_set_op(a, b, copy, universe, '&')) {
+            FAIL;
+        }
+        u32vec_free(copy);
+        copy = u32vec_from_buff(b->data, b->size);
+        u32vec_intersect(a, copy, copy);
+        if (!check_u32_set_op(a, b, copy, universe, '&')) {
+            FAIL;
+        }
+        u32vec_free(copy);
+        copy = u32vec_from_buff(a->data, a->size);
+        u32vec_difference(copy, b, copy);
+        if (!check_u32_set_op(a, b, copy, universe, '-')) {
+            FAIL;
+        }
+        u32vec_free(copy);
+
+        u32vec_free(a);
+        u32vec_free(b);
+        u32vec_free(out);
+    }
+
+    {
+        u32vec_t *a = u32vec_from({1, 2, 3, 5, 8, 13, 21, 34, 55});
+        u32vec_t *b = u32vec_from({1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21});
+        u32vec_t *c = u32vec_from({0, 1, 5, 10, 13, 20, 21, 30});
+        u32vec_t *expected = u32vec_from({1, 5, 13, 21});
+        u32vec_t *out = u32vec_new(0, 0);
+        const u32vec_t *vecs[] = {a, b, c};
+
+        u32vec_intersect_many(vecs, 3, out);
+        if (!u32vec_eq(out, expected)) {
+            FAIL;
+        }
+        u32vec_intersect_many(vecs, 1, out);
+        if (!u32vec_eq(out, a)) {
+            FAIL;
+        }
+        u32vec_intersect_many(vecs, 0, out);
+        if (out->size != 0) {
+            FAIL;
+        }
+
+        u32vec_free(a);
+        u32vec_free(b);
+        u32vec_free(c);
+        u32vec_free(expected);
+        u32vec_free(out);
+    }
+    return 0;
+}
+
+int cmp_uint32(const void *ptra, const void *ptrb) {
+    uint32_t a = *(const uint32_t *)ptra;
+    uint32_t b = *(const uint32_t *)ptrb;
+    return (a > b) - (a < b);
+}
+
+int test_extsort() {
+    char in_path[] = "/tmp/dsalgo_extsort_in.XXXXXX";
+    char out_path[] = "/tmp/dsalgo_extsort_out.XXXXXX";
+    int in_fd = mkstemp(in_path);
+    int out_fd = mkstemp(out_path);
+    if (in_fd < 0 || out_fd < 0) {
+        FAIL;
+    }
+    close(out_fd);
+
+    const size_t n = 100000;
+    u32vec_t *vec = u32vec_new(n, n);
+    srand(7);
+    for (size_t i = 0; i < n; ++i) {
+        // Plenty of duplicates
+        vec->data[i] = rand() % 50000;
+    }
+    if (write(in_fd, vec->data, n * sizeof(uint32_t)) !=
+        (ssize_t)(n * sizeof(uint32_t))) {
+        FAIL;
+    }
+    close(in_fd);
+    qsort(vec->data, n, sizeof(uint32_t), cmp_uint32);
+
+    // Budgets that go through several merge passes, a single one, and none
+    const size_t budgets[] = {16 << 10, 128 << 10, 0};
+    u32vec_t *sorted = u32vec_new(n, n);
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b) {
+        extsort_config_t config = {
+            .elsize = sizeof(uint32_t),
+            .cmp = cmp_uint32,
+            .mem_budget = budgets[b],
+        };
+        if (extsort_file(in_path, out_path, &config) != 0) {
+            FAIL;
+        }
+        FILE *out = fopen(out_path, "rb");
+        size_t got = fread(sorted->data, sizeof(uint32_t), n + 1, out);
+        fclose(out);
+        if (got != n || memcmp(sorted->data, vec->data, n * 4) != 0) {
+            FAIL;
+        }
+    }
+
+    // In place
+    extsort_config_t config = {
+        .elsize = sizeof(uint32_t),
+        .cmp = cmp_uint32,
+        .mem_budget = 16 << 10,
+    };
+    if (extsort_file(in_path, in_path, &config) != 0) {
+        FAIL;
+    }
+    FILE *in = fopen(in_path, "rb");
+    size_t got = fread(sorted->data, sizeof(uint32_t), n + 1, in);
+    fclose(in);
+    if (got != n || memcmp(sorted->data, vec->data, n * 4) != 0) {
+        FAIL;
+    }
+
+    // Not a whole number of records
+    config.elsize = 3;
+    errno = 0;
+    if (extsort_file(in_path, out_path, &config) != -1 || errno != EINVAL) {
+        FAIL;
+    }
+    config.elsize = sizeof(uint32_t);
+    errno = 0;
+    if (extsort_file("/nonexistent/file", out_path, &config) != -1 ||
+        errno != ENOENT) {
+        FAIL;
+    }
+
+    unlink(in_path);
+    unlink(out_path);
+    u32vec_free(vec);
+    u32vec_free(sorted);
+    return 0;
+}
+
+int test_rangequery() {
+    // Not a power of two, to go through the uneven parts of both layouts
+    const size_t n = 1000;
+    i64vec_t *vec = i64vec_new(n, n);
+    srand(3);
+    for (size_t i = 0; i < n; ++i) {
+        vec->data[i] = rand() % 2001 - 1000;
+    }
+
+    i64fenwick_t *sums = i64fenwick_from_vec(vec);
+    i64minsegtree_t *mins = i64minsegtree_from_vec(vec);
+    i64maxsegtree_t *maxs = i64maxsegtree_from_vec(vec);
+
+    for (int round = 0; round < 2000; ++round) {
+        size_t idx = rand() % n;
+        int64_t val = rand() % 2001 - 1000;
+        if (round % 2) {
+            i64fenwick_update(sums, idx, val - vec->data[idx]);
+        } else {
+            i64fenwick_set(sums, idx, val);
+        }
+        i64minsegtree_set(mins, idx, val);
+        i64maxsegtree_set(maxs, idx, val);
+        vec->data[idx] = val;
+
+        size_t begin = rand() % (n + 1);
+        size_t end = rand() % (n + 1);
+        int64_t sum = 0;
+        int64_t min = INT64_MAX;
+        int64_t max = INT64_MIN;
+        for (size_t i = begin; i < end; ++i) {
+            sum += vec->data[i];
+            min = vec->data[i] < min ? vec->data[i] : min;
+            max = vec->data[i] > max ? vec->data[i] : max;
+        }
+        if (i64fenwick_range(sums, begin, end) != sum ||
+            i64minsegtree_query(mins, begin, end) != min ||
+            i64maxsegtree_query(maxs, begin, end) != max) {
+            FAIL;
+        }
+        int64_t prefix = 0;
+        for (size_t i = 0; i < begin; ++i) {
+            prefix += vec->data[i];
+        }
+        if (i64fenwick_prefix(sums, begin) != prefix ||
+            i64fenwick_get(sums, idx) != val ||
+            i64minsegtree_get(mins, idx) != val) {
+            FAIL;
+        }
+    }
+    i64fenwick_free(sums);
+    i64minsegtree_free(mins);
+    i64maxsegtree_free(maxs);
+    i64vec_free(vec);
+
+    {
+        const double values[] = {0.5, 1.5, -2.0, 4.0, 0.25};
+        dvec_t *dvec = dvec_from_buff(values, 5);
+        dfenwick_t *dsums = dfenwick_from_vec(dvec);
+        dminsegtree_t *dmins = dminsegtree_new(5);
+        if (dfenwick_prefix(dsums, 5) != 4.25 ||
+            dfenwick_range(dsums, 1, 4) != 3.5 ||
+            dminsegtree_query(dmins, 0, 5) != INFINITY) {
+            FAIL;
+        }
+        dminsegtree_set(dmins, 3, -1.0);
+        if (dminsegtree_query(dmins, 0, 3) != INFINITY ||
+            dminsegtree_query(dmins, 2, 5) != -1.0) {
+            FAIL;
+        }
+        dfenwick_free(dsums);
+        dminsegtree_free(dmins);
+        dvec_free(dvec);
+    }
+
+    {
+        i64fenwick_t *empty = i64fenwick_new(0);
+        i64minsegtree_t *empty_min = i64minsegtree_new(0);
+        if (i64fenwick_prefix(empty, 10) != 0 ||
+            i64minsegtree_query(empty_min, 0, 10) != INT64_MAX) {
+            FAIL;
+        }
+        i64fenwick_free(empty);
+        i64minsegtree_free(empty_min);
+    }
+    return 0;
+}
+
+// Checks that the snapshot still holds i * 3 at every index i
+void *pvec_check_snapshot(void *arg) {
+    pvec_t *snapshot = arg;
+    intptr_t res = 0;
+    for (int round = 0; round < 20; ++round) {
+        for (size_t i = 0; i < snapshot->size; ++i) {
+            if (*(const int32_t *)pvec_at(snapshot, i) != (int32_t)i * 3) {
+                res = 1;
+            }
+        }
+    }
+    pvec_free(snapshot);
+    return (void *)res;
+}
+
+int test_pvec() {
+    const size_t n = 10000;
+    i32vec_t *vec = i32vec_new(n, n);
+    for (size_t i = 0; i < n; ++i) {
+        vec->data[i] = i * 3;
+    }
+    pvec_t *pvec = pvec_from_vec((const vec_t *)vec, sizeof(int32_t));
+    if (pvec->size != n || *(const int32_t *)pvec_at(pvec, 1234) != 3702) {
+        FAIL;
+    }
+
+    // Readers check their own snapshot while the writer keeps going
+    pthread_t threads[4];
+    for (int t = 0; t < 4; ++t) {
+        pthread_create(&threads[t], NULL, pvec_check_snapshot,
+                       pvec_snapshot(pvec));
+    }
+    pvec_t *before = pvec_snapshot(pvec);
+    for (size_t i = 0; i < n; i += 7) {
+        int32_t val = -(int32_t)i;
+        pvec_set(pvec, i, &val);
+    }
+    for (int32_t i = 0; i < 5000; ++i) {
+        pvec_append(pvec, &i);
+    }
+    for (int t = 0; t < 4; ++t) {
+        void *res;
+        pthread_join(threads[t], &res);
+        if (res != NULL) {
+            FAIL;
+        }
+    }
+
+    if (before->size != n || pvec->size != n + 5000) {
+        FAIL;
+    }
+    i32vec_t *old = (i32vec_t *)pvec_to_vec(before);
+    if (!i32vec_eq(old, vec)) {
+        FAIL;
+    }
+    for (size_t i = 0; i < n + 5000; ++i) {
+        int32_t want = i * 3;
+        if (i >= n) {
+            want = i - n;
+        } else if (i % 7 == 0) {
+            want = -(int32_t)i;
+        }
+        if (*(const int32_t *)pvec_at(pvec, i) != want) {
+            FAIL;
+        }
+    }
+
+    // Appending to a snapshot doesn't touch the original, even when they
+    // share the last chunk
+    pvec_t *branch = pvec_snapshot(before);
+    int32_t val = 42;
+    pvec_append(branch, &val);
+    pvec_append(before, &val);
+    val = 43;
+    pvec_set(before, n, &val);
+    if (*(const int32_t *)pvec_at(branch, n) != 42 ||
+        *(const int32_t *)pvec_at(before, n) != 43 || branch->size != n + 1) {
+        FAIL;
+    }
+
+    pvec_t *empty = pvec_new(sizeof(int64_t));
+    vec_t *empty_vec = pvec_to_vec(empty);
+    if (empty->size != 0 || empty_vec->size != 0) {
+        FAIL;
+    }
+
+    vec_free(empty_vec);
+    pvec_free(empty);
+    pvec_free(branch);
+    pvec_free(before);
+    pvec_free(pvec);
+    i32vec_free(old);
+    i32vec_free(vec);
+    return 0;
+}
+
+int test_strarena() {
+    strarena_t *arena = strarena_new(0);
+
+    str_t hello = strarena_push(arena, "hello", 5);
+    str_t empty = strarena_push(arena, "", 0);
+    str_t hello2 = strarena_push(arena, "hello world", 5);
+    if (strcmp(strarena_get(arena, hello), "hello") != 0 ||
+        strcmp(strarena_get(arena, empty), "") != 0 ||
+        strcmp(strarena_get(arena, hello2), "hello") != 0) {
+        FAIL;
+    }
+    // Pushed strings aren't deduplicated, but their content is equal
+    if (hello.off == hello2.off || !strarena_eq(arena, hello, hello2) ||
+        strarena_eq(arena, hello, empty)) {
+        FAIL;
+    }
+
+    // Many symbols with few distinct values
+    char name[32];
+    str_t symbols[5000];
+    for (int i = 0; i < 5000; ++i) {
+        int len = snprintf(name, sizeof(name), "symbol_%d", i % 700);
+        symbols[i] = strarena_intern(arena, name, len);
+    }
+    if (arena->ninterned != 700) {
+        FAIL;
+    }
+    for (int i = 0; i < 5000; ++i) {
+        snprintf(name, sizeof(name), "symbol_%d", i % 700);
+        if (strcmp(strarena_get(arena, symbols[i]), name) != 0 ||
+            !str_interned_eq(symbols[i], symbols[i % 700]) ||
+            (i % 700 != 0 && str_interned_eq(symbols[i], symbols[0]))) {
+            FAIL;
+        }
+    }
+
+    str_t found;
+    if (!strarena_find(arena, "symbol_42", 9, &found) ||
+        !str_interned_eq(found, symbols[42]) ||
+        strarena_find(arena, "symbol_700", 10, &found) ||
+        strarena_find(arena, "hello", 5, &found)) {
+        FAIL;
+    }
+
+    // Interning a string of the arena itself, which may move as it grows
+    size_t before = arena->buff->size;
+    str_t hello3 = strarena_intern(arena, strarena_get(arena, hello), 5);
+    if (arena->buff->size != before + 6 || !strarena_eq(arena, hello, hello3) ||
+        !str_interned_eq(hello3, strarena_intern(arena, "hello", 5))) {
+        FAIL;
+    }
+
+    strarena_free(arena);
+    return 0;
+}
+
+int test_serial() {
+    if (serial_crc32c(0, "123456789", 9) != 0xe3069283 ||
+        serial_crc32c(serial_crc32c(0, "1234", 4), "56789", 5) != 0xe3069283) {
+        FAIL;
+    }
+
+    char path[] = "/tmp/dsalgo_serial.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        FAIL;
+    }
+    unlink(path);
+
+    i64vec_t *vec = i64vec_new(1000, 1000);
+    for (size_t i = 0; i < vec->size; ++i) {
+        vec->data[i] = (int64_t)i * i - 500;
+    }
+    bitvec_t *bits = bitvec_new(0, 0);
+    for (size_t i = 0; i < 1234; ++i) {
+        bitvec_append(bits, i % 3 == 0);
+    }
+    if (vec_write(fd, (const vec_t *)vec, sizeof(int64_t)) != 0 ||
+        bitvec_write(fd, bits) != 0) {
+        FAIL;
+    }
+    size_t vec_len = vec_serialized_size((const vec_t *)vec, sizeof(int64_t));
+    size_t total = vec_len + bitvec_serialized_size(bits);
+    if (lseek(fd, 0, SEEK_CUR) != (off_t)total) {
+        FAIL;
+    }
+
+    // Read back into existing containers, that need to grow
+    lseek(fd, 0, SEEK_SET);
+    i64vec_t *vec2 = i64vec_new(0, 0);
+    bitvec_t *bits2 = bitvec_new(3, 0);
+    if (vec_read(fd, (vec_t *)vec2, sizeof(int64_t)) != 0 ||
+        bitvec_read(fd, bits2) != 0 || !i64vec_eq(vec, vec2) ||
+        vec2->size != vec->size || !bitvec_eq(bits, bits2)) {
+        FAIL;
+    }
+    // Nothing left to read
+    errno = 0;
+    if (vec_read(fd, (vec_t *)vec2, sizeof(int64_t)) != -1 ||
+        errno != EBADMSG) {
+        FAIL;
+    }
+
+    // Views over a buffer holding both
+    uint8_t *buff = malloc(total);
+    if (pread(fd, buff, total, 0) != (ssize_t)total) {
+        FAIL;
+    }
+    vec_t view;
+    bitvec_t bits_view;
+    if (vec_view(buff, vec_len, sizeof(int64_t), &view) != 0 ||
+        bitvec_view(buff + vec_len, total - vec_len, &bits_view) != 0 ||
+        view.data != buff + SERIAL_HEADER_SIZE ||
+        memcmp(view.data, vec->data, vec->size * sizeof(int64_t)) != 0 ||
+        !bitvec_eq(&bits_view, bits)) {
+        FAIL;
+    }
+    // Views don't own their data, so nothing may grow or free it
+    if (view._cap != 0 || bits_view._cap != 0) {
+        FAIL;
+    }
+
+    errno = 0;
+    if (vec_view(buff, vec_len, sizeof(int32_t), &view) != -1 ||
+        errno != EINVAL) {
+        FAIL;
+    }
+    errno = 0;
+    if (vec_view(buff, vec_len - 1, sizeof(int64_t), &view) != -1 ||
+        errno != EBADMSG) {
+        FAIL;
+    }
+    errno = 0;
+    if (vec_view(buff + vec_len, total - vec_len, 1, &view) != -1 ||
+        errno != EBADMSG) {
+        FAIL;
+    }
+    // Corrupted payload
+    buff[SERIAL_HEADER_SIZE + 42] ^= 1;
+    errno = 0;
+    if (vec_view(buff, vec_len, sizeof(int64_t), &view) != -1 ||
+        errno != EBADMSG) {
+        FAIL;
+    }
+
+    // Headers announcing far more than the input holds fail without trying
+    // to allocate it, from a regular file or from a pipe
+    uint8_t huge[2][SERIAL_HEADER_SIZE + 16];
+    memset(huge, 0, sizeof(huge));
+    memcpy(huge[0], buff, SERIAL_HEADER_SIZE);
+    memcpy(huge[1], buff + vec_len, SERIAL_HEADER_SIZE);
+    for (int i = 0; i < 8; ++i) {
+        uint64_t count = (uint64_t)1 << 43;
+        uint64_t nbytes[2] = {count * sizeof(int64_t), count / 8};
+        huge[0][16 + i] = huge[1][16 + i] = (uint8_t)(count >> (i * 8));
+        huge[0][24 + i] = (uint8_t)(nbytes[0] >> (i * 8));
+        huge[1][24 + i] = (uint8_t)(nbytes[1] >> (i * 8));
+    }
+    for (int kind = 0; kind < 2; ++kind) {
+        for (int piped = 0; piped < 2; ++piped) {
+            int in = fd;
+            int fds[2];
+            if (piped) {
+                if (pipe(fds) != 0 ||
+                    write(fds[1], huge[kind], sizeof(huge[kind])) !=
+                        sizeof(huge[kind])) {
+                    FAIL;
+                }
+                close(fds[1]);
+                in = fds[0];
+            } else if (pwrite(fd, huge[kind], sizeof(huge[kind]), 0) !=
+                           sizeof(huge[kind]) ||
+                       ftruncate(fd, sizeof(huge[kind])) != 0) {
+                FAIL;
+            } else {
+                lseek(fd, 0, SEEK_SET);
+            }
+
+            errno = 0;
+            int res = kind == 0
+                          ? vec_read(in, (vec_t *)vec2, sizeof(int64_t))
+                          : bitvec_read(in, bits2);
+            if (res != -1 || errno != EBADMSG) {
+                FAIL;
+            }
+            if (piped) {
+                close(fds[0]);
+            }
+        }
+    }
+
+    // Reading a short bitvec into a bigger one leaves no old bits behind
+    // once it grows again
+    {
+        int fds[2];
+        bitvec_t *small = bitvec_from({true, false, true});
+        bitvec_t *ones = bitvec_new(0, 0);
+        for (int i = 0; i < 64; ++i) {
+            bitvec_append(ones, true);
+        }
+        if (pipe(fds) != 0 || bitvec_write(fds[1], small) != 0 ||
+            bitvec_read(fds[0], ones) != 0 || !bitvec_eq(ones, small)) {
+            FAIL;
+        }
+        bitvec_append(ones, false);
+        bitvec_append(ones, false);
+        bitvec_set(ones, 20, true);
+        for (size_t i = 3; i < 20; ++i) {
+            if (bitvec_get(ones, i)) {
+                FAIL;
+            }
+        }
+        if (!bitvec_get(ones, 20) || ones->size != 21) {
+            FAIL;
+        }
+        close(fds[0]);
+        close(fds[1]);
+        bitvec_free(small);
+        bitvec_free(ones);
+    }
+
+    free(buff);
+    close(fd);
+    i64vec_free(vec);
+    i64vec_free(vec2);
+    bitvec_free(bits);
+    bitvec_free(bits2);
+    return 0;
+}
+
 int test_list32i_push_back() {
     list32i_t *list = list32i_new();
     int32_t val;
@@ -854,6 +1924,18 @@ int main(void) {
     RUN_TEST(test_i32vec_bubble_sort);
     RUN_TEST(test_bitvec);
     RUN_TEST(test_bitvec_two_crystal_balls);
+    RUN_TEST(test_bitvec_pack);
+    RUN_TEST(test_i32vec_bitvec_predicates);
+    RUN_TEST(test_atomic_bitvec);
+    RUN_TEST(test_bloom);
+    RUN_TEST(test_instr);
+    RUN_TEST(test_segvec);
+    RUN_TEST(test_u32vec_set_ops);
+    RUN_TEST(test_extsort);
+    RUN_TEST(test_rangequery);
+    RUN_TEST(test_pvec);
+    RUN_TEST(test_strarena);
+    RUN_TEST(test_serial);
 
     RUN_TEST(test_list32i_push_back);
     RUN_TEST(test_list32i_push_front);
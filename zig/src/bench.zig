@@ -0,0 +1,485 @@
+//! Throughput and latency of the containers against their std counterparts,
+//! for FIFO, stack and deque workloads, across queue sizes, element sizes
+//! and allocators. Run with `zig build bench [-- --ops N]`.
+//!
+//! Every run first fills the container with `queue_size` items, then does
+//! `ops` times one push and one pop, and finally drains it. One JSON object
+//! is printed per run, with the time per op of the steady phase (a single
+//! op is too short for the timer, so percentiles are over batches of ops)
+//! and what the allocator saw during the whole run.
+
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const MyArrayList = @import("./myarraylist.zig").MyArrayList;
+const MyDoublyLinkedList = @import("./mydoublylinkedlist.zig").MyDoublyLinkedList;
+const MyQueue = @import("./myqueue.zig").MyQueue;
+const MyRingBuffer = @import("./myringbuffer.zig").MyRingBuffer;
+
+/// Operations timed together
+const batch = 64;
+const default_ops = 1 << 18;
+const queue_sizes = [_]usize{ 16, 1024, 65536 };
+const elem_sizes = .{ 8, 64, 256 };
+/// Backing memory of the fixed buffer allocator
+const fixed_buffer_size = 256 << 20;
+
+const AllocatorKind = enum { page, gpa, arena, fixed };
+
+/// Forwards to another allocator and counts the calls
+const CountingAllocator = struct {
+    child: Allocator,
+    allocs: usize = 0,
+    resizes: usize = 0,
+    frees: usize = 0,
+    live_bytes: usize = 0,
+    peak_bytes: usize = 0,
+
+    fn allocator(self: *CountingAllocator) Allocator {
+        return .{
+            .ptr = self,
+            .vtable = &.{ .alloc = alloc, .resize = resize, .remap = remap, .free = free },
+        };
+    }
+
+    fn resized(self: *CountingAllocator, old_len: usize, new_len: usize) void {
+        self.live_bytes = self.live_bytes - old_len + new_len;
+        self.peak_bytes = @max(self.peak_bytes, self.live_bytes);
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const res = self.child.rawAlloc(len, alignment, ret_addr) orelse return null;
+        self.allocs += 1;
+        self.resized(0, len);
+        return res;
+    }
+
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        if (!self.child.rawResize(memory, alignment, new_len, ret_addr)) return false;
+        self.resizes += 1;
+        self.resized(memory.len, new_len);
+        return true;
+    }
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const res = self.child.rawRemap(memory, alignment, new_len, ret_addr) orelse return null;
+        self.resizes += 1;
+        self.resized(memory.len, new_len);
+        return res;
+    }
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        self.child.rawFree(memory, alignment, ret_addr);
+        self.frees += 1;
+        self.resized(memory.len, 0);
+    }
+};
+
+fn Elem(comptime size: usize) type {
+    return struct { bytes: [size]u8 };
+}
+
+fn makeElem(comptime E: type, i: usize) E {
+    return .{ .bytes = @splat(@truncate(i)) };
+}
+
+// Every implementation exposes init, deinit, push and pop, where pop takes
+// from the end the workload says
+
+fn MyQueueFifo(comptime E: type) type {
+    return struct {
+        pub const name = "MyQueue";
+        pub const workload = "fifo";
+        q: MyQueue(E),
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .q = MyQueue(E).init(alloc) };
+        }
+        fn deinit(self: *@This()) void {
+            self.q.deinit();
+        }
+        fn push(self: *@This(), v: E) !void {
+            try self.q.push(v);
+        }
+        fn pop(self: *@This()) ?E {
+            return self.q.pop();
+        }
+    };
+}
+
+fn MyRingBufferFifo(comptime E: type) type {
+    return struct {
+        pub const name = "MyRingBuffer";
+        pub const workload = "fifo";
+        rb: MyRingBuffer(E),
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .rb = MyRingBuffer(E).init(alloc) };
+        }
+        fn deinit(self: *@This()) void {
+            self.rb.deinit();
+        }
+        fn push(self: *@This(), v: E) !void {
+            try self.rb.append(v);
+        }
+        fn pop(self: *@This()) ?E {
+            return self.rb.popFirst();
+        }
+    };
+}
+
+/// What MyQueue used to be: one allocation per item
+fn MyDoublyLinkedListFifo(comptime E: type) type {
+    return struct {
+        pub const name = "MyDoublyLinkedList";
+        pub const workload = "fifo";
+        const L = MyDoublyLinkedList(E);
+        ll: L,
+        alloc: Allocator,
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .ll = L{}, .alloc = alloc };
+        }
+        fn deinit(self: *@This()) void {
+            while (self.pop()) |_| {}
+        }
+        fn push(self: *@This(), v: E) !void {
+            const node = try self.alloc.create(L.Node);
+            node.* = L.Node{ .val = v };
+            self.ll.append(node);
+        }
+        fn pop(self: *@This()) ?E {
+            const node = self.ll.popFirst() orelse return null;
+            const res = node.val;
+            self.alloc.destroy(node);
+            return res;
+        }
+    };
+}
+
+fn StdFifo(comptime E: type) type {
+    return struct {
+        pub const name = "std.fifo.LinearFifo";
+        pub const workload = "fifo";
+        const F = std.fifo.LinearFifo(E, .Dynamic);
+        f: F,
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .f = F.init(alloc) };
+        }
+        fn deinit(self: *@This()) void {
+            self.f.deinit();
+        }
+        fn push(self: *@This(), v: E) !void {
+            try self.f.writeItem(v);
+        }
+        fn pop(self: *@This()) ?E {
+            return self.f.readItem();
+        }
+    };
+}
+
+fn StdLinkedListFifo(comptime E: type) type {
+    return struct {
+        pub const name = "std.DoublyLinkedList";
+        pub const workload = "fifo";
+        const L = std.DoublyLinkedList(E);
+        ll: L,
+        alloc: Allocator,
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .ll = L{}, .alloc = alloc };
+        }
+        fn deinit(self: *@This()) void {
+            while (self.pop()) |_| {}
+        }
+        fn push(self: *@This(), v: E) !void {
+            const node = try self.alloc.create(L.Node);
+            node.* = L.Node{ .data = v };
+            self.ll.append(node);
+        }
+        fn pop(self: *@This()) ?E {
+            const node = self.ll.popFirst() orelse return null;
+            const res = node.data;
+            self.alloc.destroy(node);
+            return res;
+        }
+    };
+}
+
+fn MyArrayListStack(comptime E: type) type {
+    return struct {
+        pub const name = "MyArrayList";
+        pub const workload = "stack";
+        al: MyArrayList(E),
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .al = MyArrayList(E).init(alloc) };
+        }
+        fn deinit(self: *@This()) void {
+            self.al.deinit();
+        }
+        fn push(self: *@This(), v: E) !void {
+            try self.al.append(v);
+        }
+        fn pop(self: *@This()) ?E {
+            return self.al.pop();
+        }
+    };
+}
+
+fn StdArrayListStack(comptime E: type) type {
+    return struct {
+        pub const name = "std.ArrayList";
+        pub const workload = "stack";
+        al: std.ArrayList(E),
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .al = std.ArrayList(E).init(alloc) };
+        }
+        fn deinit(self: *@This()) void {
+            self.al.deinit();
+        }
+        fn push(self: *@This(), v: E) !void {
+            try self.al.append(v);
+        }
+        fn pop(self: *@This()) ?E {
+            return self.al.pop();
+        }
+    };
+}
+
+fn MyRingBufferDeque(comptime E: type) type {
+    return struct {
+        pub const name = "MyRingBuffer";
+        pub const workload = "deque";
+        rb: MyRingBuffer(E),
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .rb = MyRingBuffer(E).init(alloc) };
+        }
+        fn deinit(self: *@This()) void {
+            self.rb.deinit();
+        }
+        fn push(self: *@This(), v: E) !void {
+            try self.rb.prepend(v);
+        }
+        fn pop(self: *@This()) ?E {
+            return self.rb.popLast();
+        }
+    };
+}
+
+fn MyDoublyLinkedListDeque(comptime E: type) type {
+    return struct {
+        pub const name = "MyDoublyLinkedList";
+        pub const workload = "deque";
+        const L = MyDoublyLinkedList(E);
+        ll: L,
+        alloc: Allocator,
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .ll = L{}, .alloc = alloc };
+        }
+        fn deinit(self: *@This()) void {
+            while (self.pop()) |_| {}
+        }
+        fn push(self: *@This(), v: E) !void {
+            const node = try self.alloc.create(L.Node);
+            node.* = L.Node{ .val = v };
+            self.ll.prepend(node);
+        }
+        fn pop(self: *@This()) ?E {
+            const node = self.ll.popLast() orelse return null;
+            const res = node.val;
+            self.alloc.destroy(node);
+            return res;
+        }
+    };
+}
+
+fn StdLinkedListDeque(comptime E: type) type {
+    return struct {
+        pub const name = "std.DoublyLinkedList";
+        pub const workload = "deque";
+        const L = std.DoublyLinkedList(E);
+        ll: L,
+        alloc: Allocator,
+
+        fn init(alloc: Allocator) @This() {
+            return .{ .ll = L{}, .alloc = alloc };
+        }
+        fn deinit(self: *@This()) void {
+            while (self.pop()) |_| {}
+        }
+        fn push(self: *@This(), v: E) !void {
+            const node = try self.alloc.create(L.Node);
+            node.* = L.Node{ .data = v };
+            self.ll.prepend(node);
+        }
+        fn pop(self: *@This()) ?E {
+            const node = self.ll.pop() orelse return null;
+            const res = node.data;
+            self.alloc.destroy(node);
+            return res;
+        }
+    };
+}
+
+fn implementations(comptime E: type) [10]type {
+    return .{
+        MyQueueFifo(E),
+        MyRingBufferFifo(E),
+        MyDoublyLinkedListFifo(E),
+        StdFifo(E),
+        StdLinkedListFifo(E),
+        MyArrayListStack(E),
+        StdArrayListStack(E),
+        MyRingBufferDeque(E),
+        MyDoublyLinkedListDeque(E),
+        StdLinkedListDeque(E),
+    };
+}
+
+const Record = struct {
+    workload: []const u8,
+    impl: []const u8,
+    allocator: []const u8,
+    elem_size: usize,
+    queue_size: usize,
+    ops: usize,
+    @"error": ?[]const u8 = null,
+    fill_ns: u64 = 0,
+    mops_per_s: f64 = 0,
+    p50_ns: f64 = 0,
+    p90_ns: f64 = 0,
+    p99_ns: f64 = 0,
+    max_ns: f64 = 0,
+    allocs: usize = 0,
+    resizes: usize = 0,
+    frees: usize = 0,
+    peak_bytes: usize = 0,
+};
+
+/// Fills, runs and drains one implementation, filling the timings of `record`
+/// `latencies` gets the duration of each batch
+fn measure(comptime Impl: type, comptime E: type, alloc: Allocator, record: *Record, latencies: []u64) !void {
+    var impl = Impl.init(alloc);
+    defer impl.deinit();
+    var timer = try std.time.Timer.start();
+
+    for (0..record.queue_size) |i| {
+        try impl.push(makeElem(E, i));
+    }
+    record.fill_ns = timer.lap();
+
+    for (latencies, 0..) |*lat, b| {
+        for (0..batch) |i| {
+            try impl.push(makeElem(E, b * batch + i));
+            std.mem.doNotOptimizeAway(impl.pop().?);
+        }
+        lat.* = timer.lap();
+    }
+
+    while (impl.pop()) |v| {
+        std.mem.doNotOptimizeAway(v);
+    }
+
+    var total: u64 = 0;
+    for (latencies) |lat| {
+        total += lat;
+    }
+    std.mem.sort(u64, latencies, {}, std.sort.asc(u64));
+    const per_op = struct {
+        fn f(ns: u64) f64 {
+            return @as(f64, @floatFromInt(ns)) / batch;
+        }
+    }.f;
+    record.mops_per_s = @as(f64, @floatFromInt(record.ops)) * 1e3 / @as(f64, @floatFromInt(@max(total, 1)));
+    record.p50_ns = per_op(latencies[latencies.len * 50 / 100]);
+    record.p90_ns = per_op(latencies[latencies.len * 90 / 100]);
+    record.p99_ns = per_op(latencies[latencies.len * 99 / 100]);
+    record.max_ns = per_op(latencies[latencies.len - 1]);
+}
+
+fn runOne(
+    comptime Impl: type,
+    comptime E: type,
+    kind: AllocatorKind,
+    queue_size: usize,
+    latencies: []u64,
+    fixed_buffer: []u8,
+    out: anytype,
+) !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+    var fba = std.heap.FixedBufferAllocator.init(fixed_buffer);
+    var counting = CountingAllocator{ .child = switch (kind) {
+        .page => std.heap.page_allocator,
+        .gpa => gpa.allocator(),
+        .arena => arena.allocator(),
+        .fixed => fba.allocator(),
+    } };
+
+    var record = Record{
+        .workload = Impl.workload,
+        .impl = Impl.name,
+        .allocator = @tagName(kind),
+        .elem_size = @sizeOf(E),
+        .queue_size = queue_size,
+        .ops = latencies.len * batch,
+    };
+    // The fixed buffer never gets back what isn't freed last, linked lists
+    // can run out of it
+    measure(Impl, E, counting.allocator(), &record, latencies) catch |err| {
+        record.@"error" = @errorName(err);
+    };
+    record.allocs = counting.allocs;
+    record.resizes = counting.resizes;
+    record.frees = counting.frees;
+    record.peak_bytes = counting.peak_bytes;
+
+    try std.json.stringify(record, .{}, out);
+    try out.writeByte('\n');
+}
+
+pub fn main() !void {
+    const args = try std.process.argsAlloc(std.heap.page_allocator);
+    defer std.process.argsFree(std.heap.page_allocator, args);
+    var ops: usize = default_ops;
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        if (std.mem.eql(u8, args[i], "--ops") and i + 1 < args.len) {
+            i += 1;
+            ops = try std.fmt.parseInt(usize, args[i], 10);
+        } else {
+            std.debug.print("usage: bench [--ops N]\n", .{});
+            return error.InvalidArgument;
+        }
+    }
+
+    const latencies = try std.heap.page_allocator.alloc(u64, @max(ops / batch, 1));
+    defer std.heap.page_allocator.free(latencies);
+    const fixed_buffer = try std.heap.page_allocator.alloc(u8, fixed_buffer_size);
+    defer std.heap.page_allocator.free(fixed_buffer);
+
+    var bw = std.io.bufferedWriter(std.io.getStdOut().writer());
+    const out = bw.writer();
+
+    inline for (elem_sizes) |size| {
+        const E = Elem(size);
+        inline for (comptime implementations(E)) |Impl| {
+            for (queue_sizes) |queue_size| {
+                for (std.enums.values(AllocatorKind)) |kind| {
+                    try runOne(Impl, E, kind, queue_size, latencies, fixed_buffer, out);
+                }
+                try bw.flush();
+            }
+        }
+    }
+}
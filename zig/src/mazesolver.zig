@@ -36,13 +36,11 @@ pub fn mazeSolverRec(allocator: std.mem.Allocator, maze: Maze) ![]Direction {
     var res = MyArrayList(Direction).init(allocator);
     defer res.deinit();
 
-    var i: usize = 0;
-    while (maze.buf.items[i] != 'S') : (i += 1) {}
+    const i = maze.buf.find('S') orelse return error.NoStartFound;
+    const start_x = i % maze.col;
+    const start_y = i / maze.col;
 
-    const start_row = i % maze.col;
-    const start_col = i / maze.col;
-
-    const solved = try _mazeSolverRec(maze, &res, start_row, start_col);
+    const solved = try _mazeSolverRec(maze, &res, start_x, start_y);
     if (!solved) return error.NoPathFound;
 
     return res.cloneSlice();
@@ -60,12 +58,13 @@ fn _mazeSolverRec(maze: Maze, res: *MyArrayList(Direction), x: usize, y: usize)
         return true;
     }
 
-    if (maze.get(x, y) != '.') {
+    const tile = maze.get(x, y);
+    if (!_canWalk(tile)) {
         return false;
     }
 
     maze.set(x, y, 'x');
-    defer maze.set(x, y, '.');
+    defer maze.set(x, y, tile);
 
     // std.debug.print("{d} {d}\n", .{ x, y });
     // for (maze.buf.items, 0..) |tile, idx| {
@@ -78,7 +77,7 @@ fn _mazeSolverRec(maze: Maze, res: *MyArrayList(Direction), x: usize, y: usize)
 
     {
         try res.append(.West);
-        const solved = try _mazeSolverRec(maze, res, x - 1, y);
+        const solved = try _mazeSolverRec(maze, res, x -% 1, y);
         if (solved) return true;
         _ = res.pop();
     }
@@ -92,7 +91,7 @@ fn _mazeSolverRec(maze: Maze, res: *MyArrayList(Direction), x: usize, y: usize)
 
     {
         try res.append(.North);
-        const solved = try _mazeSolverRec(maze, res, x, y - 1);
+        const solved = try _mazeSolverRec(maze, res, x, y -% 1);
         if (solved) return true;
         _ = res.pop();
     }
@@ -107,11 +106,80 @@ fn _mazeSolverRec(maze: Maze, res: *MyArrayList(Direction), x: usize, y: usize)
     return false;
 }
 
-fn _canWalk(maze: Maze, x: usize, y: usize) bool {
-    const tile = maze.get(x, y);
+fn _canWalk(tile: u8) bool {
     return tile == '.' or tile == 'S' or tile == 'E';
 }
 
+/// Tries the directions in the same order as mazeSolverRec, without
+/// recursion, so the stack can't overflow on long paths
+///
+/// The current path is the stack: each frame is the direction taken from a
+/// cell, which is also the last direction tried from it. The cell itself
+/// isn't stored, backtracking walks back the way it came. Cells are marked
+/// in a bit set and stay marked, so each one is entered at most once where
+/// mazeSolverRec can go through the same dead end again by another path.
+/// Besides the result, that needs one bit per cell and one byte per step of
+/// the path, and the maze is left untouched.
+pub fn mazeSolverIter(allocator: std.mem.Allocator, maze: Maze) ![]Direction {
+    // Order in which the directions are tried, as in mazeSolverRec
+    const order = [_]Direction{ .West, .East, .North, .South };
+
+    const start = maze.buf.find('S') orelse return error.NoStartFound;
+    var x = start % maze.col;
+    var y = start / maze.col;
+
+    var visited = try std.bit_set.DynamicBitSetUnmanaged.initEmpty(allocator, maze.buf.items.len);
+    defer visited.deinit(allocator);
+    visited.set(start);
+
+    var path = MyArrayList(Direction).init(allocator);
+    defer path.deinit();
+
+    // Index in `order` of the next direction to try from (x, y)
+    var next: usize = 0;
+    while (true) {
+        if (next == order.len) {
+            // Dead end, back to the previous cell and its next direction
+            const dir = path.pop() orelse return error.NoPathFound;
+            switch (dir) {
+                .West => x += 1,
+                .East => x -= 1,
+                .North => y += 1,
+                .South => y -= 1,
+            }
+            next = std.mem.indexOfScalar(Direction, &order, dir).? + 1;
+            continue;
+        }
+
+        const dir = order[next];
+        next += 1;
+        var nx = x;
+        var ny = y;
+        switch (dir) {
+            .West => nx -%= 1,
+            .East => nx += 1,
+            .North => ny -%= 1,
+            .South => ny += 1,
+        }
+        if (nx >= maze.col or ny >= maze.row) continue;
+        const cell = ny * maze.col + nx;
+        if (visited.isSet(cell)) continue;
+
+        const tile = maze.get(nx, ny);
+        if (tile == 'E') {
+            try path.append(dir);
+            return path.cloneSlice();
+        }
+        if (!_canWalk(tile)) continue;
+
+        visited.set(cell);
+        try path.append(dir);
+        x = nx;
+        y = ny;
+        next = 0;
+    }
+}
+
 test "onetile" {
     const allocator = std.testing.allocator;
     var maze = Maze.init(allocator, 2);
@@ -119,9 +187,11 @@ test "onetile" {
 
     try maze.addRow("SE");
 
-    const res = try mazeSolverRec(allocator, maze);
-    defer allocator.free(res);
-    try std.testing.expectEqualSlices(Direction, &[_]Direction{.East}, res);
+    inline for (.{ mazeSolverRec, mazeSolverIter }) |solver| {
+        const res = try solver(allocator, maze);
+        defer allocator.free(res);
+        try std.testing.expectEqualSlices(Direction, &[_]Direction{.East}, res);
+    }
 }
 
 test "primeagent's maze" {
@@ -133,11 +203,12 @@ test "primeagent's maze" {
     try maze.addRow("#.....#");
     try maze.addRow("#S#####");
 
-    const res = try mazeSolverRec(allocator, maze);
-    defer allocator.free(res);
-
     const expected = [_]Direction{ .North, .East, .East, .East, .East, .North };
-    try std.testing.expectEqualSlices(Direction, &expected, res);
+    inline for (.{ mazeSolverRec, mazeSolverIter }) |solver| {
+        const res = try solver(allocator, maze);
+        defer allocator.free(res);
+        try std.testing.expectEqualSlices(Direction, &expected, res);
+    }
 }
 
 test "complicated maze" {
@@ -187,9 +258,6 @@ test "complicated maze" {
     try maze.addRow("#...#.....#.........#.#...............#...#.......#.#.#.......#.....#...#.#.........#.....#.....#.#.#");
     try maze.addRow("###################################################################################################.#");
 
-    const res = try mazeSolverRec(allocator, maze);
-    defer allocator.free(res);
-
     // zig fmt: off
     const expected = [_]Direction{
         .North, .North, .North, .North, .North, .North, 
@@ -219,5 +287,54 @@ test "complicated maze" {
     };
     // zig fmt: on
 
-    try std.testing.expectEqualSlices(Direction, &expected, res);
+    inline for (.{ mazeSolverRec, mazeSolverIter }) |solver| {
+        const res = try solver(allocator, maze);
+        defer allocator.free(res);
+        try std.testing.expectEqualSlices(Direction, &expected, res);
+    }
+    // The maze is left as it was
+    try std.testing.expectEqual('S', maze.get(23, 7));
+}
+
+test "no path" {
+    const allocator = std.testing.allocator;
+    var maze = Maze.init(allocator, 5);
+    defer maze.deinit();
+
+    try maze.addRow("S.#..");
+    try maze.addRow("..#.E");
+
+    inline for (.{ mazeSolverRec, mazeSolverIter }) |solver| {
+        try std.testing.expectError(error.NoPathFound, solver(allocator, maze));
+    }
+}
+
+test "long winding corridor" {
+    const allocator = std.testing.allocator;
+    const col = 1000;
+    const row = 201;
+    var maze = Maze.init(allocator, col);
+    defer maze.deinit();
+
+    // Open rows joined by a gap at alternating ends of the wall rows between
+    // them, the path goes through about 100k cells
+    var line: [col]u8 = undefined;
+    for (0..row) |y| {
+        if (y % 2 == 0) {
+            @memset(&line, '.');
+        } else {
+            @memset(&line, '#');
+            line[if (y % 4 == 1) col - 1 else 0] = '.';
+        }
+        if (y == 0) line[0] = 'S';
+        if (y == row - 1) line[col - 1] = 'E';
+        try maze.addRow(&line);
+    }
+
+    const res = try mazeSolverIter(allocator, maze);
+    defer allocator.free(res);
+    try std.testing.expectEqual(100 * (col - 1) + 100 * 2 + (col - 1), res.len);
+    try std.testing.expectEqual(.East, res[0]);
+    try std.testing.expectEqual(.South, res[col - 1]);
+    try std.testing.expectEqual(.West, res[col + 1]);
 }
@@ -2,6 +2,8 @@ const std = @import("std");
 const Allocator = std.mem.Allocator;
 const print = std.debug.print;
 const assert = std.debug.assert;
+const mysort = @import("./mysort.zig");
+const mysearch = @import("./mysearch.zig");
 
 /// Contiguous growable memory buffer
 pub fn MyArrayList(comptime T: type) type {
@@ -56,6 +58,36 @@ pub fn MyArrayList(comptime T: type) type {
             self.items.len += slice.len;
         }
 
+        /// Appends without checking the capacity, e.g. after initCapacity
+        pub fn appendAssumeCapacity(self: *Self, val: T) void {
+            assert(self.items.len < self.capacity);
+            self.items.len += 1;
+            self.items[self.items.len - 1] = val;
+        }
+
+        /// Appends without checking the capacity, e.g. after initCapacity
+        pub fn appendSliceAssumeCapacity(self: *Self, slice: []const T) void {
+            const newlen = self.items.len + slice.len;
+            assert(newlen <= self.capacity);
+            @memcpy(self.items.ptr[self.items.len..newlen], slice);
+            self.items.len = newlen;
+        }
+
+        /// Appends `n` copies of a value, growing at most once
+        pub fn appendNTimes(self: *Self, val: T, n: usize) !void {
+            const slice = try self.addManyAsSlice(n);
+            @memset(slice, val);
+        }
+
+        /// Extends the list by `n` undefined elements and returns them, to be
+        /// filled in place by the caller, growing at most once
+        pub fn addManyAsSlice(self: *Self, n: usize) ![]T {
+            const oldlen = self.items.len;
+            try self.ensureCapacity(oldlen + n);
+            self.items.len += n;
+            return self.items[oldlen..];
+        }
+
         pub fn clear(self: *Self) void {
             self.items.len = 0;
         }
@@ -69,7 +101,20 @@ pub fn MyArrayList(comptime T: type) type {
             return res;
         }
 
+        /// Changes the capacity, keeping the elements
+        /// The allocator gets a chance to resize the block in place (or move
+        /// it without copying, e.g. mremap for the page allocator) before
+        /// falling back to allocating a new block and copying.
         pub fn grow(self: *Self, new_capacity: usize) !void {
+            assert(new_capacity >= self.items.len);
+            if (self.capacity != 0 and new_capacity != 0) {
+                if (self.alloc.remap(self.items.ptr[0..self.capacity], new_capacity)) |newslice| {
+                    self.items.ptr = newslice.ptr;
+                    self.capacity = newslice.len;
+                    return;
+                }
+            }
+
             const newslice = try self.alloc.alloc(T, new_capacity);
 
             @memcpy(newslice[0..self.items.len], self.items);
@@ -89,6 +134,22 @@ pub fn MyArrayList(comptime T: type) type {
             try self.grow(newcapacity);
         }
 
+        /// Gives back the unused capacity to the allocator
+        pub fn shrinkToFit(self: *Self) void {
+            if (self.items.len == self.capacity) {
+                return;
+            }
+            if (self.items.len == 0) {
+                self.deinit();
+                self.items = &[_]T{};
+                self.capacity = 0;
+                return;
+            }
+            // Shrinking only fails if the allocator can't do it in place and
+            // has no memory left for a smaller copy, keep the extra capacity then
+            self.grow(self.items.len) catch {};
+        }
+
         pub fn cloneSlice(self: Self) ![]T {
             const res = try self.alloc.alloc(T, self.items.len);
             @memcpy(res, self.items);
@@ -105,15 +166,28 @@ pub fn MyArrayList(comptime T: type) type {
         }
 
         /// Returns the index of the first occurence of a value starting from index
+        /// Ints, floats and enums are compared a vector at a time
         pub fn findFrom(self: Self, val: T, startidx: usize) ?usize {
-            if (startidx < self.items.len) {
-                for (self.items[startidx..], startidx..) |v, i| {
-                    if (v == val) {
-                        return i;
-                    }
-                }
-            }
-            return null;
+            return mysearch.indexOfPos(T, self.items, startidx, val);
+        }
+
+        pub fn contains(self: Self, val: T) bool {
+            return self.find(val) != null;
+        }
+
+        /// Returns the number of occurences of a value
+        pub fn count(self: Self, val: T) usize {
+            return mysearch.count(T, self.items, val);
+        }
+
+        /// Returns the index of the last occurence of a value
+        pub fn lastIndexOf(self: Self, val: T) ?usize {
+            return mysearch.lastIndexOf(T, self.items, val);
+        }
+
+        /// Returns the index of the first element equal to any of the values
+        pub fn indexOfAny(self: Self, vals: []const T) ?usize {
+            return mysearch.indexOfAnyPos(T, self.items, 0, vals);
         }
 
         pub fn isSorted(self: Self) bool {
@@ -182,6 +256,44 @@ pub fn MyArrayList(comptime T: type) type {
                 }
             }
         }
+
+        /// O(n log n), not stable
+        /// Pattern-defeating quicksort, see mysort.sort
+        pub fn sort(self: *Self, context: anytype, comptime lessThan: fn (@TypeOf(context), T, T) bool) void {
+            mysort.sort(T, self.items, context, lessThan);
+        }
+
+        /// O(n log n), not stable
+        /// Sorts by increasing `keyOf(item)`, keys are compared with `<`
+        pub fn sortByKey(self: *Self, comptime K: type, comptime keyOf: fn (T) K) void {
+            const Ctx = struct {
+                fn lessThan(_: void, a: T, b: T) bool {
+                    return keyOf(a) < keyOf(b);
+                }
+            };
+            mysort.sort(T, self.items, {}, Ctx.lessThan);
+        }
+
+        /// O(n log n) with a scratch buffer of at least half the length,
+        /// O(n log² n) without, stable
+        /// Nothing is allocated, `scratch` is only used if it is big enough
+        pub fn sortStable(self: *Self, scratch: ?[]T, context: anytype, comptime lessThan: fn (@TypeOf(context), T, T) bool) void {
+            mysort.sortStable(T, self.items, scratch, context, lessThan);
+        }
+
+        /// O(n) on average
+        /// Puts at index `nth` the element that would be there if sorted, with
+        /// no greater element before it and no lesser one after it
+        /// Asserts nth < len
+        pub fn nthElement(self: *Self, nth: usize, context: anytype, comptime lessThan: fn (@TypeOf(context), T, T) bool) void {
+            mysort.nthElement(T, self.items, nth, context, lessThan);
+        }
+
+        /// O(n + k log k)
+        /// Sorts the `k` smallest elements at the front, e.g. for a top-k
+        pub fn partialSort(self: *Self, k: usize, context: anytype, comptime lessThan: fn (@TypeOf(context), T, T) bool) void {
+            mysort.partialSort(T, self.items, k, context, lessThan);
+        }
     };
 }
 
@@ -277,6 +389,33 @@ test "findFrom" {
     try expectEqual(null, al.findFrom(11, 5));
 }
 
+test "count, lastIndexOf and indexOfAny" {
+    const alloc = std.testing.allocator;
+    var al = MyArrayList(u16).init(alloc);
+    defer al.deinit();
+
+    try expectEqual(0, al.count(7));
+    try expectEqual(null, al.lastIndexOf(7));
+    try expectEqual(null, al.indexOfAny(&[_]u16{ 7, 8 }));
+    try expect(!al.contains(7));
+
+    // Long enough to go through whole vectors then the scalar tail
+    for (0..100) |i| {
+        try al.append(@intCast(i % 10));
+    }
+    try expect(al.contains(7));
+    try expect(!al.contains(10));
+    try expectEqual(10, al.count(7));
+    try expectEqual(0, al.count(10));
+    try expectEqual(97, al.lastIndexOf(7));
+    try expectEqual(90, al.lastIndexOf(0));
+    try expectEqual(null, al.lastIndexOf(10));
+    try expectEqual(3, al.indexOfAny(&[_]u16{ 10, 5, 3 }));
+    try expectEqual(null, al.indexOfAny(&[_]u16{ 10, 11 }));
+    try expectEqual(null, al.indexOfAny(&[_]u16{}));
+    try expectEqual(67, al.findFrom(7, 61));
+}
+
 test "issorted" {
     const alloc = std.testing.allocator;
     var al = MyArrayList(u8).init(alloc);
@@ -412,6 +551,55 @@ test "appendSlice" {
     try std.testing.expectEqualSlices(u8, &[_]u8{ 10, 0 }, al.items);
 }
 
+test "bulk append" {
+    const alloc = std.testing.allocator;
+    var al = try MyArrayList(u8).initCapacity(alloc, 6);
+    defer al.deinit();
+
+    al.appendAssumeCapacity(1);
+    al.appendSliceAssumeCapacity(&[_]u8{ 2, 3, 4 });
+    try std.testing.expectEqualSlices(u8, &[_]u8{ 1, 2, 3, 4 }, al.items);
+
+    try al.appendNTimes(7, 5);
+    try std.testing.expectEqualSlices(u8, &[_]u8{ 1, 2, 3, 4, 7, 7, 7, 7, 7 }, al.items);
+    try al.appendNTimes(0, 0);
+    try expectEqual(9, al.items.len);
+
+    const slice = try al.addManyAsSlice(3);
+    try expectEqual(3, slice.len);
+    for (slice, 10..) |*v, i| {
+        v.* = @intCast(i);
+    }
+    try std.testing.expectEqualSlices(u8, &[_]u8{ 1, 2, 3, 4, 7, 7, 7, 7, 7, 10, 11, 12 }, al.items);
+
+    al.shrinkToFit();
+    try expectEqual(12, al.capacity);
+    try std.testing.expectEqualSlices(u8, &[_]u8{ 1, 2, 3, 4, 7, 7, 7, 7, 7, 10, 11, 12 }, al.items);
+    al.clear();
+    al.shrinkToFit();
+    try expectEqual(0, al.capacity);
+    try al.append(5);
+    try std.testing.expectEqualSlices(u8, &[_]u8{5}, al.items);
+}
+
+test "grow in place" {
+    // The page allocator remaps big blocks instead of copying them
+    var al = MyArrayList(u32).init(std.heap.page_allocator);
+    defer al.deinit();
+
+    for (0..1 << 20) |i| {
+        try al.append(@intCast(i));
+    }
+    for (al.items, 0..) |v, i| {
+        try expectEqual(i, v);
+    }
+    _ = try al.addManyAsSlice(1000);
+    al.items.len = 1 << 20;
+    al.shrinkToFit();
+    try expectEqual(1 << 20, al.capacity);
+    try expectEqual((1 << 20) - 1, al.items[al.items.len - 1]);
+}
+
 test "bubbleSort" {
     const alloc = std.testing.allocator;
     var al = MyArrayList(u8).init(alloc);
@@ -458,3 +646,80 @@ test "bubbleSort" {
     al.bubbleSort();
     try std.testing.expectEqualSlices(u8, &[_]u8{ 0, 1 }, al.items);
 }
+
+test "sort" {
+    const alloc = std.testing.allocator;
+    var al = MyArrayList(u32).init(alloc);
+    defer al.deinit();
+
+    al.sort({}, std.sort.asc(u32));
+
+    var prng = std.Random.DefaultPrng.init(0);
+    const random = prng.random();
+    for (0..1000) |_| {
+        try al.append(random.uintLessThan(u32, 100));
+    }
+    al.sort({}, std.sort.asc(u32));
+    try expect(al.isSorted());
+    al.sort({}, std.sort.desc(u32));
+    al.revert();
+    try expect(al.isSorted());
+}
+
+const Entry = struct { id: u32, score: i32 };
+
+fn entryScore(entry: Entry) i32 {
+    return entry.score;
+}
+
+fn entryLessThan(_: void, a: Entry, b: Entry) bool {
+    return a.score < b.score;
+}
+
+test "sortByKey and sortStable" {
+    const alloc = std.testing.allocator;
+    var al = MyArrayList(Entry).init(alloc);
+    defer al.deinit();
+
+    for (0..300) |i| {
+        const id: u32 = @intCast(i);
+        const score: i32 = @intCast(id * 7 % 10);
+        try al.append(.{ .id = id, .score = score - 5 });
+    }
+
+    al.sortByKey(i32, entryScore);
+    for (1..al.items.len) |i| {
+        try expect(al.items[i - 1].score <= al.items[i].score);
+    }
+
+    // Back to id order, then stable on score keeps ids in order among ties
+    al.sortByKey(u32, struct {
+        fn f(entry: Entry) u32 {
+            return entry.id;
+        }
+    }.f);
+    var scratch: [150]Entry = undefined;
+    al.sortStable(&scratch, {}, entryLessThan);
+    for (1..al.items.len) |i| {
+        const a = al.items[i - 1];
+        const b = al.items[i];
+        try expect(a.score < b.score or (a.score == b.score and a.id < b.id));
+    }
+}
+
+test "partialSort and nthElement" {
+    const alloc = std.testing.allocator;
+    var al = MyArrayList(u32).init(alloc);
+    defer al.deinit();
+
+    for (0..500) |i| {
+        try al.append(@intCast((i * 7919) % 500));
+    }
+
+    al.nthElement(250, {}, std.sort.asc(u32));
+    try expectEqual(250, al.items[250]);
+
+    // Top 10 largest
+    al.partialSort(10, {}, std.sort.desc(u32));
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 499, 498, 497, 496, 495, 494, 493, 492, 491, 490 }, al.items[0..10]);
+}
@@ -1,4 +1,7 @@
 const std = @import("std");
+const Allocator = std.mem.Allocator;
+const assert = std.debug.assert;
+const MyArrayList = @import("./myarraylist.zig").MyArrayList;
 
 pub fn MyBufferStack(comptime T: type) type {
     return struct {
@@ -11,7 +14,8 @@ pub fn MyBufferStack(comptime T: type) type {
             return Self{ .buffer = buffer, .len = 0 };
         }
 
-        /// Panics if it goes out of bound
+        /// Panics if it goes out of bound, see MySmallStack for a stack that
+        /// grows instead
         pub fn push(self: *Self, val: T) void {
             self.buffer[self.len] = val;
             self.len += 1;
@@ -28,3 +32,131 @@ pub fn MyBufferStack(comptime T: type) type {
         }
     };
 }
+
+/// Stack that keeps up to `inline_capacity` items in a buffer inside the
+/// struct, so a local one lives on the thread stack and allocates nothing in
+/// the common case. Pushing past that moves everything once to a MyArrayList
+/// which takes over for good, so slice() is always contiguous.
+/// The struct must not move while a slice() is in use.
+pub fn MySmallStack(comptime T: type, comptime inline_capacity: usize) type {
+    return struct {
+        const Self = @This();
+
+        buffer: [inline_capacity]T = undefined,
+        /// Only counts the items in `buffer`, until the stack spills
+        buffer_len: usize = 0,
+        heap: MyArrayList(T),
+
+        pub fn init(alloc: Allocator) Self {
+            return Self{ .heap = MyArrayList(T).init(alloc) };
+        }
+
+        pub fn deinit(self: Self) void {
+            self.heap.deinit();
+        }
+
+        /// Whether the items moved to the heap
+        pub fn spilled(self: Self) bool {
+            return self.heap.capacity != 0;
+        }
+
+        pub fn len(self: Self) usize {
+            return if (self.spilled()) self.heap.items.len else self.buffer_len;
+        }
+
+        pub fn empty(self: Self) bool {
+            return self.len() == 0;
+        }
+
+        /// Bottom of the stack first
+        pub fn slice(self: *Self) []T {
+            return if (self.spilled()) self.heap.items else self.buffer[0..self.buffer_len];
+        }
+
+        pub fn top(self: *Self) ?T {
+            const items = self.slice();
+            return if (items.len == 0) null else items[items.len - 1];
+        }
+
+        pub fn push(self: *Self, val: T) !void {
+            try self.pushSlice(&[_]T{val});
+        }
+
+        /// Pushes all values with a single copy, the last one on top
+        pub fn pushSlice(self: *Self, vals: []const T) !void {
+            if (!self.spilled()) {
+                if (vals.len <= inline_capacity - self.buffer_len) {
+                    @memcpy(self.buffer[self.buffer_len..][0..vals.len], vals);
+                    self.buffer_len += vals.len;
+                    return;
+                }
+                try self.spill(self.buffer_len + vals.len);
+            }
+            try self.heap.appendSlice(vals);
+        }
+
+        pub fn pop(self: *Self) ?T {
+            if (self.empty()) return null;
+            return self.popN(1)[0];
+        }
+
+        /// Removes the top `n` items and returns them, bottom first
+        /// The slice stays valid until the next push.
+        pub fn popN(self: *Self, n: usize) []T {
+            const items = self.slice();
+            assert(n <= items.len);
+            const newlen = items.len - n;
+            if (self.spilled()) self.heap.items.len = newlen else self.buffer_len = newlen;
+            return items[newlen..];
+        }
+
+        /// Keeps the heap memory, if any
+        pub fn clear(self: *Self) void {
+            self.buffer_len = 0;
+            self.heap.clear();
+        }
+
+        /// Moves the buffer to the heap, with room for `needed` items and at
+        /// least twice the buffer
+        fn spill(self: *Self, needed: usize) !void {
+            @branchHint(.cold);
+            try self.heap.ensureCapacity(@max(needed, 2 * inline_capacity, 1));
+            self.heap.appendSliceAssumeCapacity(self.buffer[0..self.buffer_len]);
+            self.buffer_len = 0;
+        }
+    };
+}
+
+test "MySmallStack" {
+    var stack = MySmallStack(u32, 4).init(std.testing.allocator);
+    defer stack.deinit();
+
+    try std.testing.expectEqual(null, stack.pop());
+    try std.testing.expectEqual(null, stack.top());
+    try stack.push(1);
+    try stack.pushSlice(&[_]u32{ 2, 3, 4 });
+    try std.testing.expect(!stack.spilled());
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 1, 2, 3, 4 }, stack.slice());
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 3, 4 }, stack.popN(2));
+    try std.testing.expectEqual(2, stack.top());
+
+    // Overflowing the buffer keeps the order
+    try stack.pushSlice(&[_]u32{ 5, 6, 7 });
+    try std.testing.expect(stack.spilled());
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 1, 2, 5, 6, 7 }, stack.slice());
+    for (8..100) |i| try stack.push(@intCast(i));
+    try std.testing.expectEqual(97, stack.len());
+    try std.testing.expectEqual(99, stack.pop());
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 97, 98 }, stack.popN(2));
+    try std.testing.expectEqual(94, stack.len());
+
+    // Stays on the heap once spilled
+    _ = stack.popN(93);
+    try std.testing.expectEqual(1, stack.pop());
+    try std.testing.expect(stack.empty());
+    try std.testing.expect(stack.spilled());
+    try stack.push(10);
+    try std.testing.expectEqualSlices(u32, &[_]u32{10}, stack.slice());
+    stack.clear();
+    try std.testing.expect(stack.empty());
+}
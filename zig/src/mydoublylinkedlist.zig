@@ -1,6 +1,7 @@
 const std = @import("std");
 const Allocator = std.mem.Allocator;
 const assert = std.debug.assert;
+const MyArrayList = @import("./myarraylist.zig").MyArrayList;
 
 pub fn MyDoublyLinkedList(comptime T: type) type {
     return struct {
@@ -91,6 +92,141 @@ pub fn MyDoublyLinkedList(comptime T: type) type {
     };
 }
 
+/// Doubly linked list whose nodes all live in one array owned by the list,
+/// linked by u32 indices instead of pointers. Removed nodes go to a free
+/// list and are reused, so the allocator is only called when the array
+/// grows, and neighbours are often close in memory.
+/// Indices stay valid until the node is removed, even when the array moves.
+pub fn MyPooledDoublyLinkedList(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        pub const Index = u32;
+        pub const none: Index = std.math.maxInt(Index);
+
+        const Node = struct {
+            val: T,
+            prev: Index,
+            /// Next free node when on the free list
+            next: Index,
+        };
+
+        nodes: MyArrayList(Node),
+        first: Index = none,
+        last: Index = none,
+        /// Head of the list of removed nodes
+        free: Index = none,
+        len: usize = 0,
+
+        pub fn init(alloc: Allocator) Self {
+            return Self{ .nodes = MyArrayList(Node).init(alloc) };
+        }
+
+        /// Room for `capacity` nodes before the array has to grow
+        pub fn initCapacity(alloc: Allocator, capacity: usize) !Self {
+            assert(capacity < none);
+            return Self{ .nodes = try MyArrayList(Node).initCapacity(alloc, capacity) };
+        }
+
+        pub fn deinit(self: Self) void {
+            self.nodes.deinit();
+        }
+
+        pub fn empty(self: Self) bool {
+            return self.first == none;
+        }
+
+        pub fn get(self: Self, idx: Index) *T {
+            return &self.nodes.items[idx].val;
+        }
+
+        /// Index of the node after `idx`, or none
+        pub fn next(self: Self, idx: Index) Index {
+            return self.nodes.items[idx].next;
+        }
+
+        /// Index of the node before `idx`, or none
+        pub fn prev(self: Self, idx: Index) Index {
+            return self.nodes.items[idx].prev;
+        }
+
+        /// Takes a node from the free list, or from the end of the array
+        fn acquire(self: *Self, val: T) !Index {
+            if (self.free != none) {
+                const idx = self.free;
+                self.free = self.nodes.items[idx].next;
+                self.nodes.items[idx] = .{ .val = val, .prev = none, .next = none };
+                return idx;
+            }
+            if (self.nodes.items.len == none) return error.OutOfMemory;
+            try self.nodes.append(.{ .val = val, .prev = none, .next = none });
+            return @intCast(self.nodes.items.len - 1);
+        }
+
+        /// Links a node that isn't in the list between `before` and `after`,
+        /// either of which can be none
+        fn link(self: *Self, idx: Index, before: Index, after: Index) void {
+            const nodes = self.nodes.items;
+            nodes[idx].prev = before;
+            nodes[idx].next = after;
+            if (before == none) self.first = idx else nodes[before].next = idx;
+            if (after == none) self.last = idx else nodes[after].prev = idx;
+            self.len += 1;
+        }
+
+        fn unlink(self: *Self, idx: Index) void {
+            const nodes = self.nodes.items;
+            const node = nodes[idx];
+            if (node.prev == none) self.first = node.next else nodes[node.prev].next = node.next;
+            if (node.next == none) self.last = node.prev else nodes[node.next].prev = node.prev;
+            self.len -= 1;
+        }
+
+        pub fn append(self: *Self, val: T) !Index {
+            const idx = try self.acquire(val);
+            self.link(idx, self.last, none);
+            return idx;
+        }
+
+        pub fn prepend(self: *Self, val: T) !Index {
+            const idx = try self.acquire(val);
+            self.link(idx, none, self.first);
+            return idx;
+        }
+
+        pub fn insertAfter(self: *Self, idx: Index, val: T) !Index {
+            const new = try self.acquire(val);
+            self.link(new, idx, self.nodes.items[idx].next);
+            return new;
+        }
+
+        /// Unlinks the node and puts it on the free list
+        pub fn remove(self: *Self, idx: Index) T {
+            assert(!self.empty());
+            self.unlink(idx);
+            self.nodes.items[idx].next = self.free;
+            self.free = idx;
+            return self.nodes.items[idx].val;
+        }
+
+        /// O(1), without touching the free list
+        pub fn moveToFront(self: *Self, idx: Index) void {
+            if (self.first == idx) return;
+            self.unlink(idx);
+            self.link(idx, none, self.first);
+        }
+
+        pub fn popFirst(self: *Self) ?T {
+            if (self.empty()) return null;
+            return self.remove(self.first);
+        }
+
+        pub fn popLast(self: *Self) ?T {
+            if (self.empty()) return null;
+            return self.remove(self.last);
+        }
+    };
+}
+
 test "some tests" {
     const L = MyDoublyLinkedList(u8);
     var ll = L{};
@@ -162,3 +298,49 @@ test "some tests" {
     try std.testing.expectEqual(five.val, ll.popFirst().?.val);
     try std.testing.expect(ll.empty());
 }
+
+test "MyPooledDoublyLinkedList" {
+    const L = MyPooledDoublyLinkedList(u8);
+    var ll = L.init(std.testing.allocator);
+    defer ll.deinit();
+
+    try std.testing.expect(ll.empty());
+    try std.testing.expectEqual(null, ll.popFirst());
+    try std.testing.expectEqual(null, ll.popLast());
+
+    const three = try ll.append(3);
+    const one = try ll.prepend(1);
+    _ = try ll.insertAfter(one, 2);
+    const five = try ll.append(5);
+    _ = try ll.insertAfter(three, 4);
+    try std.testing.expectEqual(5, ll.len);
+    try std.testing.expectEqual(5, ll.nodes.items.len);
+
+    var expected: u8 = 1;
+    var idx = ll.first;
+    while (idx != L.none) : (idx = ll.next(idx)) {
+        try std.testing.expectEqual(expected, ll.get(idx).*);
+        expected += 1;
+    }
+    try std.testing.expectEqual(4, ll.get(ll.prev(five)).*);
+
+    try std.testing.expectEqual(3, ll.remove(three));
+    ll.moveToFront(five);
+    ll.moveToFront(five);
+    try std.testing.expectEqual(5, ll.popFirst());
+    try std.testing.expectEqual(4, ll.popLast());
+
+    // Removed nodes are reused before the array grows
+    _ = try ll.append(6);
+    _ = try ll.append(7);
+    _ = try ll.prepend(0);
+    try std.testing.expectEqual(5, ll.nodes.items.len);
+    ll.get(ll.last).* = 8;
+    try std.testing.expectEqual(0, ll.popFirst());
+    try std.testing.expectEqual(1, ll.popFirst());
+    try std.testing.expectEqual(2, ll.popFirst());
+    try std.testing.expectEqual(6, ll.popFirst());
+    try std.testing.expectEqual(8, ll.popFirst());
+    try std.testing.expect(ll.empty());
+    try std.testing.expectEqual(0, ll.len);
+}
@@ -0,0 +1,222 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const assert = std.debug.assert;
+const MyPooledDoublyLinkedList = @import("./mydoublylinkedlist.zig").MyPooledDoublyLinkedList;
+
+/// Bounded map that evicts the least recently used entry when full
+/// Entries sit in a pooled list, most recently used first, and the hash map
+/// gives the list index of each key, so get, put and evict are O(1).
+/// All the memory is allocated by init, nothing is allocated afterwards.
+pub fn LruCache(comptime K: type, comptime V: type) type {
+    return LruCacheContext(K, V, std.array_hash_map.AutoContext(K));
+}
+
+/// LruCache with a custom hash map context, see std.ArrayHashMap
+///
+/// The map is an array hash map: removing a key moves the last entry into
+/// its place and leaves no tombstone behind. A map that leaves tombstones
+/// only clears them when it grows, and this one never grows, so under
+/// steady eviction misses would end up probing the whole table.
+pub fn LruCacheContext(comptime K: type, comptime V: type, comptime Context: type) type {
+    return struct {
+        const Self = @This();
+
+        pub const Entry = struct {
+            key: K,
+            val: V,
+        };
+        const List = MyPooledDoublyLinkedList(Entry);
+        const Map = std.ArrayHashMapUnmanaged(K, List.Index, Context, !std.array_hash_map.autoEqlIsCheap(K));
+
+        alloc: Allocator,
+        list: List,
+        map: Map,
+        capacity: u32,
+        hits: u64 = 0,
+        misses: u64 = 0,
+
+        pub fn init(alloc: Allocator, capacity: u32) !Self {
+            assert(capacity > 0 and capacity < List.none);
+            var list = try List.initCapacity(alloc, capacity);
+            errdefer list.deinit();
+            var map = Map{};
+            errdefer map.deinit(alloc);
+            try map.ensureTotalCapacity(alloc, capacity);
+            return Self{ .alloc = alloc, .list = list, .map = map, .capacity = capacity };
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.map.deinit(self.alloc);
+            self.list.deinit();
+        }
+
+        pub fn len(self: Self) usize {
+            return self.list.len;
+        }
+
+        /// Returns the value and marks it as the most recently used
+        /// Counts a hit or a miss.
+        pub fn get(self: *Self, key: K) ?V {
+            const idx = self.map.get(key) orelse {
+                self.misses += 1;
+                return null;
+            };
+            self.hits += 1;
+            self.list.moveToFront(idx);
+            return self.list.get(idx).val;
+        }
+
+        /// Returns the value without touching the order nor the counters
+        pub fn peek(self: Self, key: K) ?V {
+            const idx = self.map.get(key) orelse return null;
+            return self.list.get(idx).val;
+        }
+
+        pub fn contains(self: Self, key: K) bool {
+            return self.map.contains(key);
+        }
+
+        /// Inserts or replaces the value, as the most recently used
+        /// Returns the entry evicted to make room, if any.
+        pub fn put(self: *Self, key: K, val: V) !?Entry {
+            if (self.map.get(key)) |idx| {
+                self.list.get(idx).val = val;
+                self.list.moveToFront(idx);
+                return null;
+            }
+
+            const evicted = if (self.list.len == self.capacity) self.evict() else null;
+            // Can't fail: the list reuses the evicted node, and the map keeps
+            // room for capacity keys
+            const idx = try self.list.prepend(.{ .key = key, .val = val });
+            self.map.putAssumeCapacityNoClobber(key, idx);
+            return evicted;
+        }
+
+        /// Removes the least recently used entry
+        pub fn evict(self: *Self) ?Entry {
+            const entry = self.list.popLast() orelse return null;
+            assert(self.map.swapRemove(entry.key));
+            return entry;
+        }
+
+        pub fn remove(self: *Self, key: K) ?V {
+            const kv = self.map.fetchSwapRemove(key) orelse return null;
+            return self.list.remove(kv.value).val;
+        }
+
+        /// Share of the lookups that were hits, in [0; 1]
+        pub fn hitRate(self: Self) f64 {
+            const total = self.hits + self.misses;
+            if (total == 0) return 0;
+            return @as(f64, @floatFromInt(self.hits)) / @as(f64, @floatFromInt(total));
+        }
+    };
+}
+
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+
+test "LruCache" {
+    var cache = try LruCache(u32, u64).init(std.testing.allocator, 3);
+    defer cache.deinit();
+
+    try expectEqual(null, cache.get(1));
+    try expectEqual(null, try cache.put(1, 10));
+    try expectEqual(null, try cache.put(2, 20));
+    try expectEqual(null, try cache.put(3, 30));
+    try expectEqual(3, cache.len());
+
+    // 1 becomes the most recent, so 2 goes first
+    try expectEqual(10, cache.get(1));
+    const evicted = (try cache.put(4, 40)).?;
+    try expectEqual(2, evicted.key);
+    try expectEqual(20, evicted.val);
+    try expect(!cache.contains(2));
+    try expectEqual(null, cache.get(2));
+
+    // Replacing a value doesn't evict
+    try expectEqual(null, try cache.put(3, 33));
+    try expectEqual(3, cache.len());
+    try expectEqual(33, cache.peek(3));
+
+    // peek doesn't refresh 1, which is now the oldest
+    try expectEqual(10, cache.peek(1));
+    try expectEqual(1, (try cache.put(5, 50)).?.key);
+
+    try expectEqual(40, cache.remove(4));
+    try expectEqual(null, cache.remove(4));
+    try expectEqual(2, cache.len());
+    try expectEqual(50, cache.get(5));
+    try expectEqual(null, try cache.put(6, 60));
+
+    try expectEqual(2, cache.hits);
+    try expectEqual(2, cache.misses);
+    try expectEqual(0.5, cache.hitRate());
+
+    try expectEqual(3, cache.evict().?.key);
+    try expectEqual(5, cache.evict().?.key);
+    try expectEqual(6, cache.evict().?.key);
+    try expectEqual(null, cache.evict());
+}
+
+test "LruCache stays within its memory" {
+    var cache = try LruCache(u64, u64).init(std.testing.allocator, 100);
+    defer cache.deinit();
+    const nodes = cache.list.nodes.capacity;
+    const slots = cache.map.capacity();
+
+    var prng = std.Random.DefaultPrng.init(42);
+    const random = prng.random();
+    for (0..100_000) |_| {
+        const key = random.uintLessThan(u64, 300);
+        if (cache.get(key) == null) {
+            _ = try cache.put(key, key * 2);
+        }
+    }
+    try expectEqual(100, cache.len());
+    try expectEqual(nodes, cache.list.nodes.capacity);
+    try expectEqual(slots, cache.map.capacity());
+    try expect(cache.hitRate() > 0.2 and cache.hitRate() < 0.5);
+}
+
+/// Counts the keys compared, which is the number of slots probed as it
+/// doesn't store hashes for integer keys
+const CountingContext = struct {
+    var compared: usize = 0;
+
+    pub fn hash(_: CountingContext, key: u64) u32 {
+        return std.array_hash_map.getAutoHashFn(u64, void)({}, key);
+    }
+
+    pub fn eql(_: CountingContext, a: u64, b: u64, _: usize) bool {
+        compared += 1;
+        return a == b;
+    }
+};
+
+test "LruCache lookups stay short under churn" {
+    const capacity = 64;
+    var cache = try LruCacheContext(u64, u64, CountingContext).init(std.testing.allocator, capacity);
+    defer cache.deinit();
+
+    // Every key is new, so each step misses, then evicts and inserts, a
+    // thousand times over the capacity
+    const steps = 1000 * capacity;
+    CountingContext.compared = 0;
+    for (0..steps) |key| {
+        try expectEqual(null, cache.get(key));
+        _ = try cache.put(key, key);
+    }
+    try expectEqual(capacity, cache.len());
+    // A get, a put and an eviction, each a couple of slots at most, where
+    // tombstones would make every miss scan the whole table
+    try expect(CountingContext.compared < 8 * steps);
+
+    // Hits among the last keys don't degrade either
+    CountingContext.compared = 0;
+    for (steps - capacity..steps) |key| {
+        try expectEqual(key, cache.get(key));
+    }
+    try expect(CountingContext.compared < 3 * capacity);
+}
@@ -0,0 +1,259 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const posix = std.posix;
+const assert = std.debug.assert;
+
+const page_size_min = std.heap.page_size_min;
+
+/// Byte ring buffer whose pages are mapped twice, back to back: the byte at
+/// data[i + capacity] is the byte at data[i]. Whatever the position of the
+/// first byte, the content and the free space are then each a single
+/// contiguous slice, so a message that wraps around can be parsed in place
+/// and a single read(2) or write(2) moves everything.
+///
+/// The pages come from a memfd, which needs no privilege, so this is Linux
+/// only. The capacity is a power of two multiple of the page size.
+pub const MyMirroredRing = struct {
+    const Self = @This();
+
+    comptime {
+        if (builtin.os.tag != .linux) @compileError("MyMirroredRing needs memfd_create");
+    }
+
+    /// 2 * capacity bytes, the second half mirrors the first
+    data: []align(page_size_min) u8,
+    capacity: usize,
+    /// [0; capacity[, index of the first byte
+    first: usize,
+    len: usize,
+
+    /// Maps at least `capacity` bytes, and at least one page
+    pub fn init(capacity: usize) !Self {
+        const data = try mapMirrored(roundCapacity(capacity));
+        return Self{
+            .data = data,
+            .capacity = data.len / 2,
+            .first = 0,
+            .len = 0,
+        };
+    }
+
+    pub fn deinit(self: Self) void {
+        posix.munmap(self.data);
+    }
+
+    pub fn empty(self: Self) bool {
+        return self.len == 0;
+    }
+
+    pub fn prepend(self: *Self, byte: u8) !void {
+        try self.ensureCapacity(self.len + 1);
+        self.first = (self.first -% 1) & (self.capacity - 1);
+        self.data[self.first] = byte;
+        self.len += 1;
+    }
+
+    pub fn append(self: *Self, byte: u8) !void {
+        try self.appendSlice(&[_]u8{byte});
+    }
+
+    /// Appends all bytes with a single copy
+    pub fn appendSlice(self: *Self, bytes: []const u8) !void {
+        try self.ensureCapacity(self.len + bytes.len);
+        @memcpy(self.writableSlice()[0..bytes.len], bytes);
+        self.commitWritten(bytes.len);
+    }
+
+    pub fn popFirst(self: *Self) ?u8 {
+        if (self.empty()) {
+            return null;
+        }
+        const res = self.data[self.first];
+        self.discard(1);
+        return res;
+    }
+
+    /// Moves the first bytes to `buf` with a single copy
+    /// Returns the number of bytes moved, less than buf.len only if the
+    /// buffer runs out of bytes
+    pub fn popFirstInto(self: *Self, buf: []u8) usize {
+        const count = @min(buf.len, self.len);
+        @memcpy(buf[0..count], self.readableSlice()[0..count]);
+        self.discard(count);
+        return count;
+    }
+
+    pub fn popLast(self: *Self) ?u8 {
+        if (self.empty()) {
+            return null;
+        }
+        self.len -= 1;
+        return self.data[self.first + self.len];
+    }
+
+    /// asserts idx < self.len
+    pub fn at(self: Self, idx: usize) u8 {
+        assert(idx < self.len);
+        return self.data[self.first + idx];
+    }
+
+    /// The bytes in order, in one piece even when they wrap around
+    pub fn readableSlice(self: Self) []u8 {
+        return self.data[self.first..][0..self.len];
+    }
+
+    /// The free space after the last byte, in one piece
+    pub fn writableSlice(self: Self) []u8 {
+        return self.data[self.first + self.len .. self.first + self.capacity];
+    }
+
+    /// Same as MyRingBuffer.readableSlices, the second slice is always empty
+    pub fn readableSlices(self: Self) [2][]u8 {
+        return .{ self.readableSlice(), self.data[0..0] };
+    }
+
+    /// Same as MyRingBuffer.writableSlices, the second slice is always empty
+    pub fn writableSlices(self: Self) [2][]u8 {
+        return .{ self.writableSlice(), self.data[0..0] };
+    }
+
+    /// Makes the first `n` bytes of writableSlice part of the buffer
+    pub fn commitWritten(self: *Self, n: usize) void {
+        assert(n <= self.capacity - self.len);
+        self.len += n;
+    }
+
+    /// Drops the first `n` bytes
+    pub fn discard(self: *Self, n: usize) void {
+        assert(n <= self.len);
+        self.first = (self.first + n) & (self.capacity - 1);
+        self.len -= n;
+    }
+
+    /// Power of two number of pages holding at least `capacity` bytes
+    fn roundCapacity(capacity: usize) usize {
+        const page_size = std.heap.pageSize();
+        const pages = std.math.divCeil(usize, @max(capacity, 1), page_size) catch unreachable;
+        return (std.math.ceilPowerOfTwo(usize, pages) catch std.math.maxInt(usize)) *| page_size;
+    }
+
+    /// Moves the bytes to the front of a new mapping with room for at least
+    /// `capacity` bytes
+    pub fn ensureCapacity(self: *Self, capacity: usize) !void {
+        if (capacity <= self.capacity) return;
+
+        const newdata = try mapMirrored(roundCapacity(capacity));
+        @memcpy(newdata[0..self.len], self.readableSlice());
+        self.deinit();
+        self.data = newdata;
+        self.capacity = newdata.len / 2;
+        self.first = 0;
+    }
+
+    /// Maps `capacity` bytes of a new memfd twice in a row
+    fn mapMirrored(capacity: usize) ![]align(page_size_min) u8 {
+        if (capacity > std.math.maxInt(usize) / 2) return error.OutOfMemory;
+        const fd = try posix.memfd_create("mymirroredring", std.os.linux.MFD.CLOEXEC);
+        defer posix.close(fd);
+        try posix.ftruncate(fd, capacity);
+
+        // Reserve the whole range first, so that nothing else can be mapped
+        // between the two views
+        const res = try posix.mmap(null, 2 * capacity, posix.PROT.NONE, .{ .TYPE = .PRIVATE, .ANONYMOUS = true }, -1, 0);
+        errdefer posix.munmap(res);
+
+        const prot = posix.PROT.READ | posix.PROT.WRITE;
+        for (0..2) |i| {
+            const view: [*]align(page_size_min) u8 = @alignCast(res[i * capacity ..].ptr);
+            _ = try posix.mmap(view, capacity, prot, .{ .TYPE = .SHARED, .FIXED = true }, fd, 0);
+        }
+        return res;
+    }
+};
+
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+
+test "MyMirroredRing" {
+    var rb = try MyMirroredRing.init(0);
+    defer rb.deinit();
+
+    try expect(rb.empty());
+    try expectEqual(null, rb.popFirst());
+    try expectEqual(null, rb.popLast());
+    try rb.append(10);
+    try rb.append(11);
+    try rb.prepend(9);
+    try expectEqual(std.heap.pageSize(), rb.capacity);
+    try expectEqual(9, rb.at(0));
+    try expectEqual(11, rb.at(2));
+    try expectEqual(9, rb.popFirst());
+    try expectEqual(11, rb.popLast());
+    try expectEqual(10, rb.popLast());
+    try expect(rb.empty());
+
+    // Both views share the same pages
+    rb.data[5] = 42;
+    try expectEqual(42, rb.data[rb.capacity + 5]);
+    rb.data[2 * rb.capacity - 1] = 43;
+    try expectEqual(43, rb.data[rb.capacity - 1]);
+}
+
+test "MyMirroredRing wrap around" {
+    var rb = try MyMirroredRing.init(1);
+    defer rb.deinit();
+    const capacity = rb.capacity;
+
+    // Move the start close to the end, then write a message over the edge
+    const filler = try std.testing.allocator.alloc(u8, capacity - 3);
+    defer std.testing.allocator.free(filler);
+    @memset(filler, '.');
+    try rb.appendSlice(filler);
+    rb.discard(filler.len);
+
+    try rb.appendSlice("hello world");
+    try expectEqual(capacity - 3, rb.first);
+    try std.testing.expectEqualSlices(u8, "hello world", rb.readableSlice());
+    try expectEqual('l', rb.at(3));
+    try expectEqual(capacity - 11, rb.writableSlice().len);
+
+    var out: [5]u8 = undefined;
+    try expectEqual(5, rb.popFirstInto(&out));
+    try std.testing.expectEqualSlices(u8, "hello", &out);
+    try expectEqual(2, rb.first);
+    try std.testing.expectEqualSlices(u8, " world", rb.readableSlice());
+
+    // Growing keeps the content
+    try rb.ensureCapacity(capacity + 1);
+    try expectEqual(2 * capacity, rb.capacity);
+    try std.testing.expectEqualSlices(u8, " world", rb.readableSlice());
+    try expectEqual('d', rb.popLast());
+}
+
+test "MyMirroredRing read and write" {
+    var rb = try MyMirroredRing.init(1);
+    defer rb.deinit();
+
+    const fds = try posix.pipe();
+    defer posix.close(fds[0]);
+    defer posix.close(fds[1]);
+
+    try rb.appendSlice("xxxxx");
+    rb.discard(5);
+    rb.first = rb.capacity - 2;
+
+    // A single read fills the space across the edge
+    _ = try posix.write(fds[1], "0123456");
+    const got = try posix.read(fds[0], rb.writableSlice());
+    try expectEqual(7, got);
+    rb.commitWritten(got);
+    try std.testing.expectEqualSlices(u8, "0123456", rb.readableSlice());
+    try std.testing.expectEqualSlices(u8, "23456", rb.data[0..5]);
+
+    const put = try posix.write(fds[1], rb.readableSlice());
+    rb.discard(put);
+    try expect(rb.empty());
+    var out: [7]u8 = undefined;
+    try expectEqual(7, try posix.read(fds[0], &out));
+    try std.testing.expectEqualSlices(u8, "0123456", &out);
+}
@@ -0,0 +1,462 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const assert = std.debug.assert;
+
+const cache_line = std.atomic.cache_line;
+
+/// Fixed capacity queue that any number of threads can push to and pop from,
+/// without locks (Dmitry Vyukov's bounded MPMC queue).
+///
+/// Every cell has a sequence number telling which lap of the ring it is
+/// ready for: a producer claims position p by moving the enqueue position
+/// forward once the cell's sequence is p, fills it and sets the sequence to
+/// p + 1, which is what the consumer of position p waits for; the consumer
+/// then sets it to p + capacity for the producer of the next lap. Threads
+/// only contend on the position counters, each on its own cache line, and
+/// nothing is allocated after init.
+pub fn MyMpmcQueue(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        const Cell = struct {
+            seq: std.atomic.Value(usize),
+            val: T,
+        };
+
+        allocator: Allocator,
+        /// Power of two length
+        cells: []Cell,
+        enqueue_pos: std.atomic.Value(usize) align(cache_line),
+        dequeue_pos: std.atomic.Value(usize) align(cache_line),
+
+        /// Rounds the capacity up to a power of two
+        /// The queue must not move once the threads use it.
+        pub fn init(allocator: Allocator, capacity: usize) !Self {
+            assert(capacity > 0);
+            const cells = try allocator.alloc(Cell, try std.math.ceilPowerOfTwo(usize, capacity));
+            for (cells, 0..) |*cell, i| {
+                cell.seq = .init(i);
+            }
+            return Self{
+                .allocator = allocator,
+                .cells = cells,
+                .enqueue_pos = .init(0),
+                .dequeue_pos = .init(0),
+            };
+        }
+
+        pub fn deinit(self: Self) void {
+            self.allocator.free(self.cells);
+        }
+
+        /// Returns false if the queue is full
+        pub fn tryPush(self: *Self, item: T) bool {
+            var pos = self.enqueue_pos.load(.monotonic);
+            const cell = while (true) {
+                const cell = &self.cells[pos & (self.cells.len - 1)];
+                const seq = cell.seq.load(.acquire);
+                const diff: isize = @bitCast(seq -% pos);
+                if (diff == 0) {
+                    pos = self.enqueue_pos.cmpxchgWeak(pos, pos +% 1, .monotonic, .monotonic) orelse break cell;
+                } else if (diff < 0) {
+                    // The cell still holds the item of the previous lap
+                    return false;
+                } else {
+                    // Another producer took this position
+                    pos = self.enqueue_pos.load(.monotonic);
+                }
+            };
+            cell.val = item;
+            cell.seq.store(pos +% 1, .release);
+            return true;
+        }
+
+        /// Returns null if the queue is empty
+        pub fn tryPop(self: *Self) ?T {
+            var pos = self.dequeue_pos.load(.monotonic);
+            const cell = while (true) {
+                const cell = &self.cells[pos & (self.cells.len - 1)];
+                const seq = cell.seq.load(.acquire);
+                const diff: isize = @bitCast(seq -% (pos +% 1));
+                if (diff == 0) {
+                    pos = self.dequeue_pos.cmpxchgWeak(pos, pos +% 1, .monotonic, .monotonic) orelse break cell;
+                } else if (diff < 0) {
+                    // Nothing was pushed at this position yet
+                    return null;
+                } else {
+                    pos = self.dequeue_pos.load(.monotonic);
+                }
+            };
+            const res = cell.val;
+            cell.seq.store(pos +% self.cells.len, .release);
+            return res;
+        }
+    };
+}
+
+/// Unbounded queue that any number of threads can push to and pop from,
+/// without locks (the segmented design of crossbeam's SegQueue).
+///
+/// Items live in blocks of a few thousand slots chained together, so the
+/// allocator is called once per block rather than once per item. Positions
+/// count slots, with one extra position per block that marks the switch to
+/// the next one. The producer taking the last slot of a block installs the
+/// next block (allocated beforehand so that the others wait as little as
+/// possible), and the consumers free a block once all its slots were read:
+/// the consumer of the last slot frees it, unless some reader is still
+/// busy, which then finishes the job.
+/// The allocator must be thread safe.
+pub fn MySegmentedQueue(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        /// Positions per block, the last one is not a slot
+        const lap = 4096;
+        const block_cap = lap - 1;
+        /// Positions are stored shifted, to make room for the has_next flag
+        const shift = 1;
+        /// Set on the head position when the head block has a next one, so
+        /// that consumers don't need to look at the tail
+        const has_next: usize = 1;
+
+        // Slot states
+        const written = 1;
+        const read = 2;
+        const destroy = 4;
+
+        const Slot = struct {
+            val: T,
+            state: std.atomic.Value(usize),
+        };
+
+        const Block = struct {
+            next: std.atomic.Value(?*Block),
+            slots: [block_cap]Slot,
+
+            fn waitNext(self: *Block) *Block {
+                while (true) {
+                    if (self.next.load(.acquire)) |next| return next;
+                    std.atomic.spinLoopHint();
+                }
+            }
+        };
+
+        const Position = struct {
+            index: std.atomic.Value(usize) align(cache_line),
+            block: std.atomic.Value(?*Block),
+        };
+
+        allocator: Allocator,
+        head: Position,
+        tail: Position,
+
+        pub fn init(allocator: Allocator) Self {
+            return Self{
+                .allocator = allocator,
+                .head = .{ .index = .init(0), .block = .init(null) },
+                .tail = .{ .index = .init(0), .block = .init(null) },
+            };
+        }
+
+        /// Frees the blocks, no thread may use the queue anymore
+        pub fn deinit(self: *Self) void {
+            var head = self.head.index.raw & ~has_next;
+            const tail = self.tail.index.raw & ~has_next;
+            var block = self.head.block.raw;
+            while (head != tail) : (head +%= 1 << shift) {
+                if ((head >> shift) % lap == block_cap) {
+                    const next = block.?.next.raw;
+                    self.allocator.destroy(block.?);
+                    block = next;
+                }
+            }
+            if (block) |b| {
+                self.allocator.destroy(b);
+            }
+        }
+
+        fn newBlock(self: *Self) !*Block {
+            const res = try self.allocator.create(Block);
+            res.next = .init(null);
+            for (&res.slots) |*slot| {
+                slot.state = .init(0);
+            }
+            return res;
+        }
+
+        /// Frees the block, unless a reader of one of the slots from `start`
+        /// on is still busy, in which case that reader will
+        fn destroyBlock(self: *Self, block: *Block, start: usize) void {
+            // The reader of the last slot is the one who starts destruction
+            for (block.slots[start .. block_cap - 1]) |*slot| {
+                if (slot.state.load(.acquire) & read == 0 and
+                    slot.state.fetchOr(destroy, .acq_rel) & read == 0)
+                {
+                    return;
+                }
+            }
+            self.allocator.destroy(block);
+        }
+
+        pub fn push(self: *Self, item: T) !void {
+            var tail = self.tail.index.load(.acquire);
+            var block = self.tail.block.load(.acquire);
+            var next_block: ?*Block = null;
+            defer if (next_block) |b| self.allocator.destroy(b);
+
+            while (true) {
+                const offset = (tail >> shift) % lap;
+                if (offset == block_cap) {
+                    // Another producer is installing the next block
+                    std.Thread.yield() catch {};
+                    tail = self.tail.index.load(.acquire);
+                    block = self.tail.block.load(.acquire);
+                    continue;
+                }
+                if (offset + 1 == block_cap and next_block == null) {
+                    next_block = try self.newBlock();
+                }
+                if (block == null) {
+                    // Very first push
+                    const new = try self.newBlock();
+                    if (self.tail.block.cmpxchgStrong(null, new, .release, .monotonic) == null) {
+                        self.head.block.store(new, .release);
+                        block = new;
+                    } else {
+                        if (next_block) |b| self.allocator.destroy(b);
+                        next_block = new;
+                        tail = self.tail.index.load(.acquire);
+                        block = self.tail.block.load(.acquire);
+                        continue;
+                    }
+                }
+
+                const new_tail = tail +% (1 << shift);
+                if (self.tail.index.cmpxchgWeak(tail, new_tail, .seq_cst, .acquire)) |current| {
+                    tail = current;
+                    block = self.tail.block.load(.acquire);
+                    std.atomic.spinLoopHint();
+                    continue;
+                }
+
+                const b = block.?;
+                if (offset + 1 == block_cap) {
+                    // Took the last slot, skip the extra position
+                    const next = next_block.?;
+                    next_block = null;
+                    self.tail.block.store(next, .release);
+                    self.tail.index.store(new_tail +% (1 << shift), .release);
+                    b.next.store(next, .release);
+                }
+                const slot = &b.slots[offset];
+                slot.val = item;
+                _ = slot.state.fetchOr(written, .release);
+                return;
+            }
+        }
+
+        /// Returns null if the queue is empty
+        pub fn pop(self: *Self) ?T {
+            var head = self.head.index.load(.seq_cst);
+            var block = self.head.block.load(.acquire);
+
+            while (true) {
+                const offset = (head >> shift) % lap;
+                if (offset == block_cap) {
+                    // Another consumer is moving to the next block
+                    std.Thread.yield() catch {};
+                    head = self.head.index.load(.seq_cst);
+                    block = self.head.block.load(.acquire);
+                    continue;
+                }
+
+                var new_head = head +% (1 << shift);
+                if (new_head & has_next == 0) {
+                    const tail = self.tail.index.load(.seq_cst);
+                    if (head >> shift == tail >> shift) {
+                        return null;
+                    }
+                    if ((head >> shift) / lap != (tail >> shift) / lap) {
+                        new_head |= has_next;
+                    }
+                }
+
+                const b = block orelse {
+                    // The first push hasn't installed its block yet
+                    std.Thread.yield() catch {};
+                    head = self.head.index.load(.seq_cst);
+                    block = self.head.block.load(.acquire);
+                    continue;
+                };
+
+                if (self.head.index.cmpxchgWeak(head, new_head, .seq_cst, .seq_cst)) |current| {
+                    head = current;
+                    block = self.head.block.load(.acquire);
+                    std.atomic.spinLoopHint();
+                    continue;
+                }
+
+                if (offset + 1 == block_cap) {
+                    const next = b.waitNext();
+                    var next_index = (new_head & ~has_next) +% (1 << shift);
+                    if (next.next.load(.monotonic) != null) {
+                        next_index |= has_next;
+                    }
+                    self.head.block.store(next, .release);
+                    self.head.index.store(next_index, .release);
+                }
+
+                const slot = &b.slots[offset];
+                while (slot.state.load(.acquire) & written == 0) {
+                    std.atomic.spinLoopHint();
+                }
+                const res = slot.val;
+                if (offset + 1 == block_cap) {
+                    self.destroyBlock(b, 0);
+                } else if (slot.state.fetchOr(read, .acq_rel) & destroy != 0) {
+                    self.destroyBlock(b, offset + 1);
+                }
+                return res;
+            }
+        }
+
+        /// Only a hint while other threads run
+        pub fn empty(self: *const Self) bool {
+            return self.head.index.load(.seq_cst) >> shift == self.tail.index.load(.seq_cst) >> shift;
+        }
+    };
+}
+
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+
+test "MyMpmcQueue" {
+    var q = try MyMpmcQueue(u32).init(std.testing.allocator, 3);
+    defer q.deinit();
+
+    try expectEqual(4, q.cells.len);
+    try expectEqual(null, q.tryPop());
+    for (0..10) |lap| {
+        for (0..4) |i| {
+            try expect(q.tryPush(@intCast(lap * 4 + i)));
+        }
+        try expect(!q.tryPush(100));
+        for (0..4) |i| {
+            try expectEqual(lap * 4 + i, q.tryPop());
+        }
+        try expectEqual(null, q.tryPop());
+    }
+}
+
+test "MySegmentedQueue" {
+    var q = MySegmentedQueue(u32).init(std.testing.allocator);
+    defer q.deinit();
+
+    try expect(q.empty());
+    try expectEqual(null, q.pop());
+
+    // Goes through several blocks, and leaves some items for deinit
+    const Q = MySegmentedQueue(u32);
+    const n: u32 = 3 * Q.block_cap + 10;
+    for (0..n) |i| {
+        try q.push(@intCast(i));
+    }
+    try expect(!q.empty());
+    for (0..n - 100) |i| {
+        try expectEqual(i, q.pop());
+    }
+    for (0..Q.block_cap) |i| {
+        try q.push(@intCast(n + i));
+    }
+    for (n - 100..n + 50) |i| {
+        try expectEqual(i, q.pop());
+    }
+}
+
+/// Items are (producer << 32) | sequence, so that consumers can check that
+/// every producer's items come out in order
+fn pushMany(q: anytype, producer: u64, n: u64) void {
+    for (0..n) |i| {
+        q.push(producer << 32 | i);
+    }
+}
+
+fn popMany(q: anytype, nproducers: usize, total: *std.atomic.Value(u64), remaining: *std.atomic.Value(usize)) void {
+    var last = [_]?u64{null} ** 8;
+    var sum: u64 = 0;
+    while (remaining.load(.monotonic) > 0) {
+        const item = q.tryPop() orelse {
+            std.atomic.spinLoopHint();
+            continue;
+        };
+        const producer = item >> 32;
+        const seq = item & 0xffff_ffff;
+        assert(producer < nproducers);
+        if (last[producer]) |prev| assert(seq > prev);
+        last[producer] = seq;
+        sum += seq;
+        _ = remaining.fetchSub(1, .monotonic);
+    }
+    _ = total.fetchAdd(sum, .monotonic);
+}
+
+fn checkConcurrent(q: anytype, nproducers: usize, nconsumers: usize, n: u64) !void {
+    var total = std.atomic.Value(u64).init(0);
+    var remaining = std.atomic.Value(usize).init(nproducers * n);
+    var threads: [16]std.Thread = undefined;
+    for (0..nproducers) |i| {
+        threads[i] = try std.Thread.spawn(.{}, pushMany, .{ q, i, n });
+    }
+    for (0..nconsumers) |i| {
+        threads[nproducers + i] = try std.Thread.spawn(.{}, popMany, .{ q, nproducers, &total, &remaining });
+    }
+    for (threads[0 .. nproducers + nconsumers]) |t| {
+        t.join();
+    }
+    try expectEqual(nproducers * (n * (n - 1) / 2), total.load(.monotonic));
+    try expectEqual(null, q.tryPop());
+}
+
+/// Waiting push on top of tryPush, for pushMany
+fn BlockingMpmc(comptime T: type) type {
+    return struct {
+        q: MyMpmcQueue(T),
+
+        fn push(self: *@This(), item: T) void {
+            while (!self.q.tryPush(item)) {
+                std.atomic.spinLoopHint();
+            }
+        }
+
+        fn tryPop(self: *@This()) ?T {
+            return self.q.tryPop();
+        }
+    };
+}
+
+/// The interface of pushMany and popMany on top of push and pop
+fn SegmentedAdapter(comptime T: type) type {
+    return struct {
+        q: MySegmentedQueue(T),
+
+        fn push(self: *@This(), item: T) void {
+            self.q.push(item) catch @panic("OOM");
+        }
+
+        fn tryPop(self: *@This()) ?T {
+            return self.q.pop();
+        }
+    };
+}
+
+test "MyMpmcQueue across threads" {
+    var q = BlockingMpmc(u64){ .q = try MyMpmcQueue(u64).init(std.testing.allocator, 64) };
+    defer q.q.deinit();
+    try checkConcurrent(&q, 4, 4, 50_000);
+}
+
+test "MySegmentedQueue across threads" {
+    var q = SegmentedAdapter(u64){ .q = MySegmentedQueue(u64).init(std.testing.allocator) };
+    defer q.q.deinit();
+    try checkConcurrent(&q, 4, 4, 50_000);
+}
@@ -0,0 +1,244 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const assert = std.debug.assert;
+
+/// Growable list of structs stored field by field (struct of arrays): each
+/// field of T lives in its own contiguous array, so scanning one field only
+/// reads that field. All arrays share a single allocation, laid out by
+/// decreasing alignment so that none of them needs padding.
+pub fn MyMultiArrayList(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        pub const Field = std.meta.FieldEnum(T);
+        const fields = @typeInfo(T).@"struct".fields;
+
+        comptime {
+            assert(@sizeOf(T) != 0);
+        }
+
+        /// Field indices, most aligned first
+        const order = blk: {
+            var res: [fields.len]usize = undefined;
+            for (&res, 0..) |*idx, i| idx.* = i;
+            for (1..res.len) |i| {
+                var j = i;
+                while (j > 0 and @alignOf(fields[res[j]].type) > @alignOf(fields[res[j - 1]].type)) : (j -= 1) {
+                    std.mem.swap(usize, &res[j], &res[j - 1]);
+                }
+            }
+            break :blk res;
+        };
+        const alignment = @alignOf(fields[order[0]].type);
+
+        bytes: [*]align(alignment) u8,
+        len: usize,
+        capacity: usize,
+        alloc: Allocator,
+
+        pub fn init(alloc: Allocator) Self {
+            return Self{
+                .bytes = undefined,
+                .len = 0,
+                .capacity = 0,
+                .alloc = alloc,
+            };
+        }
+
+        pub fn initCapacity(alloc: Allocator, capacity: usize) !Self {
+            var res = Self.init(alloc);
+            errdefer res.deinit();
+            try res.grow(capacity);
+            return res;
+        }
+
+        pub fn deinit(self: Self) void {
+            if (self.capacity != 0) {
+                self.alloc.free(self.bytes[0..byteSize(self.capacity)]);
+            }
+        }
+
+        /// Bytes taken by one element, without the padding of T
+        const elem_size = blk: {
+            var res: usize = 0;
+            for (fields) |f| res += @sizeOf(f.type);
+            break :blk res;
+        };
+
+        /// Size of the allocation holding `capacity` elements
+        fn byteSize(capacity: usize) usize {
+            return elem_size * capacity;
+        }
+
+        fn FieldType(comptime field: Field) type {
+            return @FieldType(T, @tagName(field));
+        }
+
+        /// Array of a field in an allocation holding `capacity` elements
+        fn fieldArray(bytes: [*]align(alignment) u8, capacity: usize, comptime field: Field) [*]FieldType(field) {
+            var offset: usize = 0;
+            inline for (order) |idx| {
+                if (idx == @intFromEnum(field)) {
+                    return @ptrCast(@alignCast(bytes + offset));
+                }
+                offset += @sizeOf(fields[idx].type) * capacity;
+            }
+            unreachable;
+        }
+
+        /// Returns the values of one field, valid until the list grows
+        pub fn items(self: Self, comptime field: Field) []FieldType(field) {
+            if (self.capacity == 0) {
+                return &[_]FieldType(field){};
+            }
+            return fieldArray(self.bytes, self.capacity, field)[0..self.len];
+        }
+
+        pub fn get(self: Self, idx: usize) T {
+            assert(idx < self.len);
+            var res: T = undefined;
+            inline for (fields, 0..) |f, i| {
+                @field(res, f.name) = self.items(@enumFromInt(i))[idx];
+            }
+            return res;
+        }
+
+        pub fn set(self: Self, idx: usize, val: T) void {
+            assert(idx < self.len);
+            inline for (fields, 0..) |f, i| {
+                self.items(@enumFromInt(i))[idx] = @field(val, f.name);
+            }
+        }
+
+        pub fn append(self: *Self, val: T) !void {
+            try self.ensureCapacity(self.len + 1);
+            self.len += 1;
+            self.set(self.len - 1, val);
+        }
+
+        pub fn clear(self: *Self) void {
+            self.len = 0;
+        }
+
+        pub fn pop(self: *Self) ?T {
+            if (self.len == 0) {
+                return null;
+            }
+            const res = self.get(self.len - 1);
+            self.len -= 1;
+            return res;
+        }
+
+        pub fn empty(self: Self) bool {
+            return self.len == 0;
+        }
+
+        /// Moves every field array to a new allocation of `new_capacity`
+        /// elements, one memcpy per field
+        pub fn grow(self: *Self, new_capacity: usize) !void {
+            assert(new_capacity >= self.len);
+            const newbytes = try self.alloc.alignedAlloc(u8, alignment, byteSize(new_capacity));
+
+            inline for (0..fields.len) |i| {
+                const field: Field = @enumFromInt(i);
+                const dst = fieldArray(newbytes.ptr, new_capacity, field);
+                @memcpy(dst[0..self.len], self.items(field));
+            }
+            self.deinit();
+            self.bytes = newbytes.ptr;
+            self.capacity = new_capacity;
+        }
+
+        pub fn ensureCapacity(self: *Self, capacity: usize) !void {
+            if (capacity <= self.capacity) {
+                return;
+            }
+            var newcapacity = self.capacity;
+            while (newcapacity < capacity) {
+                newcapacity = (newcapacity + 1) * 2;
+            }
+            try self.grow(newcapacity);
+        }
+    };
+}
+
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+
+const Particle = struct {
+    alive: bool,
+    id: u32,
+    pos: f64,
+    kind: u8,
+    vel: [3]f32,
+};
+
+test "MyMultiArrayList" {
+    const alloc = std.testing.allocator;
+    var list = MyMultiArrayList(Particle).init(alloc);
+    defer list.deinit();
+
+    try expect(list.empty());
+    try expectEqual(0, list.items(.id).len);
+    try expectEqual(null, list.pop());
+
+    for (0..100) |i| {
+        try list.append(.{
+            .alive = i % 3 == 0,
+            .id = @intCast(i),
+            .pos = @floatFromInt(i * 2),
+            .kind = @intCast(i % 7),
+            .vel = .{ 1, 2, @floatFromInt(i) },
+        });
+    }
+    try expectEqual(100, list.len);
+    try expect(list.capacity >= 100);
+
+    // Each field is a plain slice, in insertion order
+    for (list.items(.id), list.items(.pos), list.items(.alive), 0..) |id, pos, alive, i| {
+        try expectEqual(i, id);
+        try expectEqual(@as(f64, @floatFromInt(i * 2)), pos);
+        try expectEqual(i % 3 == 0, alive);
+    }
+
+    const p = list.get(41);
+    try expectEqual(41, p.id);
+    try expectEqual(6, p.kind);
+    try expectEqual(41.0, p.vel[2]);
+
+    list.items(.kind)[41] = 0;
+    try expectEqual(0, list.get(41).kind);
+
+    list.set(0, .{ .alive = false, .id = 1000, .pos = -1, .kind = 1, .vel = .{ 0, 0, 0 } });
+    try expectEqual(1000, list.items(.id)[0]);
+    try expectEqual(false, list.items(.alive)[0]);
+
+    const last = list.pop().?;
+    try expectEqual(99, last.id);
+    try expectEqual(99, list.len);
+
+    list.clear();
+    try expect(list.empty());
+}
+
+test "MyMultiArrayList layout" {
+    const alloc = std.testing.allocator;
+    var list = try MyMultiArrayList(Particle).initCapacity(alloc, 5);
+    defer list.deinit();
+
+    try list.append(.{ .alive = true, .id = 1, .pos = 0.5, .kind = 2, .vel = .{ 1, 2, 3 } });
+    try list.ensureCapacity(33);
+    try list.append(.{ .alive = false, .id = 2, .pos = 1.5, .kind = 3, .vel = .{ 4, 5, 6 } });
+
+    // The arrays follow each other by decreasing alignment, without gaps
+    const base = @intFromPtr(list.bytes);
+    try expectEqual(base, @intFromPtr(list.items(.pos).ptr));
+    try expectEqual(base + 8 * list.capacity, @intFromPtr(list.items(.id).ptr));
+    try expectEqual(base + 12 * list.capacity, @intFromPtr(list.items(.vel).ptr));
+    try expectEqual(base + 24 * list.capacity, @intFromPtr(list.items(.alive).ptr));
+    try expectEqual(base + 25 * list.capacity, @intFromPtr(list.items(.kind).ptr));
+
+    try expectEqual(1, list.get(0).id);
+    try expectEqual(5.0, list.get(1).vel[1]);
+    try expectEqual(0.5, list.items(.pos)[0]);
+}
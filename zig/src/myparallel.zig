@@ -0,0 +1,528 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const Pool = std.Thread.Pool;
+const WaitGroup = std.Thread.WaitGroup;
+const assert = std.debug.assert;
+const mysort = @import("./mysort.zig");
+const mysearch = @import("./mysearch.zig");
+
+/// Slices up to this length are processed on the calling thread, spawning
+/// would cost more than the work
+pub const sequential_cutoff = 1 << 14;
+/// Upper bound on the number of chunks, enough for every core to get several
+/// so that uneven chunks even out
+const max_chunks = 256;
+/// Chunks are never shorter than this
+const min_chunk = sequential_cutoff / 4;
+/// sort splits into at most this many buckets
+const max_buckets = 64;
+/// sort draws this many samples per bucket to choose the splitters
+const oversampling = 16;
+
+/// Split of a slice into chunks of equal length (but the last).
+/// It only depends on the length, never on the number of threads, so that
+/// reduce and scan combine the same partial results in the same order on
+/// every machine, which matters for floating point operations.
+const Chunks = struct {
+    len: usize,
+    size: usize,
+    count: usize,
+
+    fn init(len: usize) Chunks {
+        if (len <= sequential_cutoff) {
+            return .{ .len = len, .size = @max(len, 1), .count = 1 };
+        }
+        const size = @max(min_chunk, std.math.divCeil(usize, len, max_chunks) catch unreachable);
+        return .{ .len = len, .size = size, .count = std.math.divCeil(usize, len, size) catch unreachable };
+    }
+
+    fn start(self: Chunks, i: usize) usize {
+        return i * self.size;
+    }
+
+    fn end(self: Chunks, i: usize) usize {
+        return @min((i + 1) * self.size, self.len);
+    }
+};
+
+/// Calls `func(ctx, i)` for every i below `count`, on the pool threads and on
+/// the calling thread, and returns once all calls did
+fn forEach(pool: *Pool, count: usize, ctx: anytype, comptime func: fn (@TypeOf(ctx), usize) void) void {
+    if (count == 1) {
+        return func(ctx, 0);
+    }
+    var wg: WaitGroup = .{};
+    for (0..count) |i| {
+        pool.spawnWg(&wg, func, .{ ctx, i });
+    }
+    pool.waitAndWork(&wg);
+}
+
+/// O(n / threads)
+/// Folds all items with `op`, which must be associative, with `init` its
+/// identity (e.g. 0 for a sum). Chunks are folded in parallel then their
+/// results in order, so the result is the same for any number of threads.
+pub fn reduce(
+    pool: *Pool,
+    comptime T: type,
+    items: []const T,
+    init: T,
+    context: anytype,
+    comptime op: fn (@TypeOf(context), T, T) T,
+) T {
+    const Ctx = struct {
+        items: []const T,
+        init: T,
+        context: @TypeOf(context),
+        chunks: Chunks,
+        partials: []T,
+
+        fn run(c: *const @This(), i: usize) void {
+            var acc = c.init;
+            for (c.items[c.chunks.start(i)..c.chunks.end(i)]) |v| {
+                acc = op(c.context, acc, v);
+            }
+            c.partials[i] = acc;
+        }
+    };
+
+    var partials: [max_chunks]T = undefined;
+    const ctx = Ctx{
+        .items = items,
+        .init = init,
+        .context = context,
+        .chunks = Chunks.init(items.len),
+        .partials = &partials,
+    };
+    forEach(pool, ctx.chunks.count, &ctx, Ctx.run);
+
+    var res = partials[0];
+    for (partials[1..ctx.chunks.count]) |p| {
+        res = op(context, res, p);
+    }
+    return res;
+}
+
+/// O(n / threads)
+/// Writes `f(src[i])` to `dst[i]` for every i
+pub fn map(
+    pool: *Pool,
+    comptime T: type,
+    comptime U: type,
+    src: []const T,
+    dst: []U,
+    context: anytype,
+    comptime f: fn (@TypeOf(context), T) U,
+) void {
+    assert(src.len == dst.len);
+    const Ctx = struct {
+        src: []const T,
+        dst: []U,
+        context: @TypeOf(context),
+        chunks: Chunks,
+
+        fn run(c: *const @This(), i: usize) void {
+            const from = c.chunks.start(i);
+            const to = c.chunks.end(i);
+            for (c.src[from..to], c.dst[from..to]) |v, *out| {
+                out.* = f(c.context, v);
+            }
+        }
+    };
+
+    const ctx = Ctx{ .src = src, .dst = dst, .context = context, .chunks = Chunks.init(src.len) };
+    forEach(pool, ctx.chunks.count, &ctx, Ctx.run);
+}
+
+/// O(n / threads)
+/// Inclusive prefix scan in place: items[i] becomes the fold of
+/// items[0..i + 1] with `op`, which must be associative.
+/// Each chunk is scanned on its own, the chunk totals are scanned on the
+/// calling thread, then every chunk is offset by the total of those before.
+pub fn scan(
+    pool: *Pool,
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime op: fn (@TypeOf(context), T, T) T,
+) void {
+    if (items.len == 0) return;
+    const Ctx = struct {
+        items: []T,
+        context: @TypeOf(context),
+        chunks: Chunks,
+        totals: []T,
+
+        fn scanChunk(c: *const @This(), i: usize) void {
+            const chunk = c.items[c.chunks.start(i)..c.chunks.end(i)];
+            for (1..chunk.len) |j| {
+                chunk[j] = op(c.context, chunk[j - 1], chunk[j]);
+            }
+            c.totals[i] = chunk[chunk.len - 1];
+        }
+
+        fn offsetChunk(c: *const @This(), i: usize) void {
+            const offset = c.totals[i];
+            for (c.items[c.chunks.start(i + 1)..c.chunks.end(i + 1)]) |*v| {
+                v.* = op(c.context, offset, v.*);
+            }
+        }
+    };
+
+    var totals: [max_chunks]T = undefined;
+    const ctx = Ctx{ .items = items, .context = context, .chunks = Chunks.init(items.len), .totals = &totals };
+    forEach(pool, ctx.chunks.count, &ctx, Ctx.scanChunk);
+    if (ctx.chunks.count == 1) return;
+
+    for (1..ctx.chunks.count) |i| {
+        totals[i] = op(context, totals[i - 1], totals[i]);
+    }
+    // Chunk i + 1 is offset by totals[i], the first chunk is already right
+    forEach(pool, ctx.chunks.count - 1, &ctx, Ctx.offsetChunk);
+}
+
+/// O(n / threads)
+/// Returns the number of occurences of `val`
+pub fn count(pool: *Pool, comptime T: type, items: []const T, val: T) usize {
+    const Ctx = struct {
+        items: []const T,
+        val: T,
+        chunks: Chunks,
+        partials: []usize,
+
+        fn run(c: *const @This(), i: usize) void {
+            c.partials[i] = mysearch.count(T, c.items[c.chunks.start(i)..c.chunks.end(i)], c.val);
+        }
+    };
+
+    var partials: [max_chunks]usize = undefined;
+    const ctx = Ctx{ .items = items, .val = val, .chunks = Chunks.init(items.len), .partials = &partials };
+    forEach(pool, ctx.chunks.count, &ctx, Ctx.run);
+
+    var res: usize = 0;
+    for (partials[0..ctx.chunks.count]) |p| {
+        res += p;
+    }
+    return res;
+}
+
+/// O(n / threads)
+/// Returns the index of the first occurence of `val`
+/// Chunks that start after a match found by another thread are skipped.
+pub fn find(pool: *Pool, comptime T: type, items: []const T, val: T) ?usize {
+    const none = std.math.maxInt(usize);
+    const Ctx = struct {
+        items: []const T,
+        val: T,
+        chunks: Chunks,
+        best: std.atomic.Value(usize),
+
+        fn run(c: *@This(), i: usize) void {
+            const from = c.chunks.start(i);
+            if (from >= c.best.load(.monotonic)) return;
+            const chunk = c.items[from..c.chunks.end(i)];
+            if (mysearch.indexOfPos(T, chunk, 0, c.val)) |idx| {
+                _ = c.best.fetchMin(from + idx, .monotonic);
+            }
+        }
+    };
+
+    var ctx = Ctx{ .items = items, .val = val, .chunks = Chunks.init(items.len), .best = .init(none) };
+    forEach(pool, ctx.chunks.count, &ctx, Ctx.run);
+
+    const res = ctx.best.load(.monotonic);
+    return if (res == none) null else res;
+}
+
+/// O(n log n / threads), not stable
+/// Sample sort: splitters picked from a random sample cut the items into
+/// buckets, every chunk scatters its items to their bucket in a scratch
+/// buffer, then the buckets are sorted in parallel and copied back.
+/// Items equal to a splitter get a bucket of their own which needs no
+/// sorting, so that many duplicates don't end up in a single huge bucket.
+/// Allocates a scratch buffer as big as `items`.
+pub fn sort(
+    pool: *Pool,
+    allocator: Allocator,
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) !void {
+    const n = items.len;
+    if (n <= sequential_cutoff) {
+        mysort.sort(T, items, context, lessThan);
+        return;
+    }
+    const chunks = Chunks.init(n);
+
+    // The seed is fixed so that the buckets, and the order of equivalent
+    // items, are the same from one run to the next
+    const wanted = @min(max_buckets, chunks.count);
+    const samples = try allocator.alloc(T, wanted * oversampling);
+    defer allocator.free(samples);
+    var prng = std.Random.DefaultPrng.init(n);
+    const random = prng.random();
+    for (samples) |*s| {
+        s.* = items[random.uintLessThan(usize, n)];
+    }
+    mysort.sort(T, samples, context, lessThan);
+
+    // Distinct splitters, written over the front of the sample
+    var nsplitters: usize = 0;
+    for (1..wanted) |b| {
+        const s = samples[b * oversampling];
+        if (nsplitters == 0 or lessThan(context, samples[nsplitters - 1], s)) {
+            samples[nsplitters] = s;
+            nsplitters += 1;
+        }
+    }
+    // Bucket 2k holds items between splitters k - 1 and k, 2k + 1 items
+    // equal to splitter k
+    const nbuckets = 2 * nsplitters + 1;
+
+    const scratch = try allocator.alloc(T, n);
+    defer allocator.free(scratch);
+    const ids = try allocator.alloc(u8, n);
+    defer allocator.free(ids);
+    // Number of items of each chunk in each bucket, then where they go
+    const slots = try allocator.alloc(usize, chunks.count * nbuckets);
+    defer allocator.free(slots);
+    @memset(slots, 0);
+    var bounds: [2 * max_buckets + 1]usize = undefined;
+
+    const Ctx = struct {
+        items: []T,
+        scratch: []T,
+        ids: []u8,
+        slots: []usize,
+        bounds: []usize,
+        splitters: []const T,
+        nbuckets: usize,
+        context: @TypeOf(context),
+        chunks: Chunks,
+
+        fn bucketOf(c: *const @This(), val: T) u8 {
+            var lo: usize = 0;
+            var hi = c.splitters.len;
+            while (lo < hi) {
+                const mid = lo + (hi - lo) / 2;
+                if (lessThan(c.context, c.splitters[mid], val)) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            const equal = lo < c.splitters.len and !lessThan(c.context, val, c.splitters[lo]);
+            return @intCast(2 * lo + @intFromBool(equal));
+        }
+
+        fn classify(c: *const @This(), i: usize) void {
+            const counts = c.slots[i * c.nbuckets ..][0..c.nbuckets];
+            for (c.chunks.start(i)..c.chunks.end(i)) |j| {
+                const b = c.bucketOf(c.items[j]);
+                c.ids[j] = b;
+                counts[b] += 1;
+            }
+        }
+
+        fn scatter(c: *const @This(), i: usize) void {
+            const next = c.slots[i * c.nbuckets ..][0..c.nbuckets];
+            for (c.chunks.start(i)..c.chunks.end(i)) |j| {
+                const b = c.ids[j];
+                c.scratch[next[b]] = c.items[j];
+                next[b] += 1;
+            }
+        }
+
+        fn sortBucket(c: *const @This(), b: usize) void {
+            const from = c.bounds[b];
+            const to = c.bounds[b + 1];
+            if (b % 2 == 0) {
+                mysort.sort(T, c.scratch[from..to], c.context, lessThan);
+            }
+            @memcpy(c.items[from..to], c.scratch[from..to]);
+        }
+    };
+
+    const ctx = Ctx{
+        .items = items,
+        .scratch = scratch,
+        .ids = ids,
+        .slots = slots,
+        .bounds = &bounds,
+        .splitters = samples[0..nsplitters],
+        .nbuckets = nbuckets,
+        .context = context,
+        .chunks = chunks,
+    };
+    forEach(pool, chunks.count, &ctx, Ctx.classify);
+
+    // Buckets follow each other, and inside a bucket the chunks do
+    var total: usize = 0;
+    for (0..nbuckets) |b| {
+        bounds[b] = total;
+        for (0..chunks.count) |i| {
+            const cnt = slots[i * nbuckets + b];
+            slots[i * nbuckets + b] = total;
+            total += cnt;
+        }
+    }
+    bounds[nbuckets] = total;
+    assert(total == n);
+
+    forEach(pool, chunks.count, &ctx, Ctx.scatter);
+    forEach(pool, nbuckets, &ctx, Ctx.sortBucket);
+}
+
+const MyArrayList = @import("./myarraylist.zig").MyArrayList;
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+
+fn testPool(pool: *Pool, n_jobs: usize) !void {
+    try pool.init(.{ .allocator = std.testing.allocator, .n_jobs = n_jobs });
+}
+
+fn add(_: void, a: u64, b: u64) u64 {
+    return a + b;
+}
+
+fn addf(_: void, a: f64, b: f64) f64 {
+    return a + b;
+}
+
+fn square(_: void, a: u32) u64 {
+    return @as(u64, a) * a;
+}
+
+fn asc(_: void, a: u32, b: u32) bool {
+    return a < b;
+}
+
+test "parallel reduce and map" {
+    var pool: Pool = undefined;
+    try testPool(&pool, 4);
+    defer pool.deinit();
+
+    const alloc = std.testing.allocator;
+    for ([_]usize{ 0, 1, 1000, sequential_cutoff + 1, 300_000 }) |n| {
+        var src = MyArrayList(u32).init(alloc);
+        defer src.deinit();
+        var dst = MyArrayList(u64).init(alloc);
+        defer dst.deinit();
+        for (0..n) |i| {
+            try src.append(@intCast(i));
+        }
+        _ = try dst.addManyAsSlice(n);
+
+        map(&pool, u32, u64, src.items, dst.items, {}, square);
+        for (dst.items, 0..) |v, i| {
+            try expectEqual(i * i, v);
+        }
+
+        var expected: u64 = 0;
+        for (dst.items) |v| {
+            expected += v;
+        }
+        try expectEqual(expected, reduce(&pool, u64, dst.items, 0, {}, add));
+    }
+}
+
+test "parallel reduce is deterministic" {
+    var pool4: Pool = undefined;
+    try testPool(&pool4, 4);
+    defer pool4.deinit();
+    var pool1: Pool = undefined;
+    try testPool(&pool1, 1);
+    defer pool1.deinit();
+
+    const alloc = std.testing.allocator;
+    var al = MyArrayList(f64).init(alloc);
+    defer al.deinit();
+    var prng = std.Random.DefaultPrng.init(42);
+    const random = prng.random();
+    for (0..200_000) |_| {
+        try al.append(random.float(f64) * 1e10 - 5e9);
+    }
+
+    // Floating point addition isn't associative, the split must not depend
+    // on the thread count for the sums to match to the last bit
+    const a = reduce(&pool4, f64, al.items, 0, {}, addf);
+    const b = reduce(&pool1, f64, al.items, 0, {}, addf);
+    try expectEqual(a, b);
+}
+
+test "parallel scan" {
+    var pool: Pool = undefined;
+    try testPool(&pool, 4);
+    defer pool.deinit();
+
+    const alloc = std.testing.allocator;
+    for ([_]usize{ 0, 1, 17, sequential_cutoff, sequential_cutoff + 1, 250_003 }) |n| {
+        var al = MyArrayList(u64).init(alloc);
+        defer al.deinit();
+        for (0..n) |i| {
+            try al.append(i % 13);
+        }
+
+        scan(&pool, u64, al.items, {}, add);
+        var expected: u64 = 0;
+        for (al.items, 0..) |v, i| {
+            expected += i % 13;
+            try expectEqual(expected, v);
+        }
+    }
+}
+
+test "parallel find and count" {
+    var pool: Pool = undefined;
+    try testPool(&pool, 4);
+    defer pool.deinit();
+
+    const alloc = std.testing.allocator;
+    var al = MyArrayList(u32).init(alloc);
+    defer al.deinit();
+    try al.appendNTimes(0, 500_000);
+
+    try expectEqual(null, find(&pool, u32, al.items, 1));
+    try expectEqual(0, count(&pool, u32, al.items, 1));
+
+    for ([_]usize{ 499_999, 250_000, 100_000, 12, 100_001 }) |idx| {
+        al.items[idx] = 1;
+    }
+    try expectEqual(12, find(&pool, u32, al.items, 1));
+    try expectEqual(5, count(&pool, u32, al.items, 1));
+    try expectEqual(0, find(&pool, u32, al.items, 0));
+    try expectEqual(500_000 - 5, count(&pool, u32, al.items, 0));
+}
+
+test "parallel sort" {
+    var pool: Pool = undefined;
+    try testPool(&pool, 4);
+    defer pool.deinit();
+
+    const alloc = std.testing.allocator;
+    var prng = std.Random.DefaultPrng.init(42);
+    const random = prng.random();
+
+    for ([_]usize{ 0, 100, sequential_cutoff + 1, 200_000 }) |n| {
+        // Random, few distinct values, and already sorted
+        for ([_]u32{ std.math.maxInt(u32), 3, 0 }) |range| {
+            var al = MyArrayList(u32).init(alloc);
+            defer al.deinit();
+            for (0..n) |i| {
+                const v: u32 = switch (range) {
+                    0 => @intCast(i),
+                    else => random.uintAtMost(u32, range),
+                };
+                try al.append(v);
+            }
+            var expected = try al.clone();
+            defer expected.deinit();
+            std.mem.sort(u32, expected.items, {}, asc);
+
+            try sort(&pool, alloc, u32, al.items, {}, asc);
+            try std.testing.expectEqualSlices(u32, expected.items, al.items);
+        }
+    }
+}
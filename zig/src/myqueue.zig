@@ -1,46 +1,34 @@
 const std = @import("std");
-const MyDoublyLinkedList = @import("./mydoublylinkedlist.zig").MyDoublyLinkedList;
+const MyRingBuffer = @import("./myringbuffer.zig").MyRingBuffer;
 const Allocator = std.mem.Allocator;
 
-/// TODO: Do we ever want to use a SinglyLinkedList over a RingBuffer?
+/// FIFO queue in a ring buffer: items are stored inline and the allocator is
+/// only called when the ring grows, instead of once per item.
+/// See mympmcqueue.zig for queues shared between threads.
 pub fn MyQueue(comptime T: type) type {
     return struct {
         const Self = @This();
-        // Could be a Singly linked list
-        const L = MyDoublyLinkedList(T);
 
-        ll: L,
-        allocator: Allocator,
+        ring: MyRingBuffer(T),
 
         pub fn init(allocator: Allocator) Self {
-            return Self{ .ll = L{}, .allocator = allocator };
+            return Self{ .ring = MyRingBuffer(T).init(allocator) };
         }
 
         pub fn deinit(self: *Self) void {
-            _ = self;
+            self.ring.deinit();
         }
 
         pub fn push(self: *Self, item: T) !void {
-            // TODO: is there a way to not allocate each node individually?
-            // Would using an ArrayList instead be faster? Until how many items?
-            // Or maybe that depends on the allocator?
-            const n = try self.allocator.create(L.Node);
-            n.* = L.Node{ .val = item };
-            self.ll.append(n);
+            try self.ring.append(item);
         }
 
         pub fn pop(self: *Self) ?T {
-            if (self.ll.first) |first| {
-                const res = first.*.val;
-                self.ll.remove(first);
-                self.allocator.destroy(first);
-                return res;
-            }
-            return null;
+            return self.ring.popFirst();
         }
 
         pub fn empty(self: Self) bool {
-            return self.ll.first == null;
+            return self.ring.empty();
         }
     };
 }
@@ -2,15 +2,18 @@ const std = @import("std");
 const Allocator = std.mem.Allocator;
 const assert = std.debug.assert;
 
+/// Double-ended queue in a circular buffer
+/// The capacity is always a power of two, so that wrapping an index around
+/// is a mask instead of a division.
 pub fn MyRingBuffer(comptime T: type) type {
     return struct {
         const Self = @This();
 
         allocator: Allocator,
         data: []T,
-        /// [0; len], index of the first element
+        /// [0; data.len[, index of the first element
         first: usize,
-        /// [0; len], index after the last element
+        /// [0; data.len[, index after the last element
         last: usize,
         // if first == last, then either len == 0 or len == data.len
         len: usize,
@@ -42,11 +45,21 @@ pub fn MyRingBuffer(comptime T: type) type {
 
         pub fn append(self: *Self, item: T) !void {
             try self.ensureCapacity(self.len + 1);
-            self.data[self.last % self.data.len] = item;
+            self.data[self.last] = item;
             self.last = self.idxAfter(self.last);
             self.len += 1;
         }
 
+        /// Appends all items, with at most two copies
+        pub fn appendSlice(self: *Self, items: []const T) !void {
+            try self.ensureCapacity(self.len + items.len);
+            const parts = self.writableSlices();
+            const n = @min(parts[0].len, items.len);
+            @memcpy(parts[0][0..n], items[0..n]);
+            @memcpy(parts[1][0 .. items.len - n], items[n..]);
+            self.commitWritten(items.len);
+        }
+
         pub fn popFirst(self: *Self) ?T {
             if (self.empty()) {
                 return null;
@@ -57,6 +70,19 @@ pub fn MyRingBuffer(comptime T: type) type {
             return self.data[oldfirst];
         }
 
+        /// Moves the first elements to `buf`, with at most two copies
+        /// Returns the number of elements moved, less than buf.len only if
+        /// the buffer runs out of elements
+        pub fn popFirstInto(self: *Self, buf: []T) usize {
+            const count = @min(buf.len, self.len);
+            const parts = self.readableSlices();
+            const n = @min(parts[0].len, count);
+            @memcpy(buf[0..n], parts[0][0..n]);
+            @memcpy(buf[n..count], parts[1][0 .. count - n]);
+            self.discard(count);
+            return count;
+        }
+
         pub fn popLast(self: *Self) ?T {
             if (self.empty()) {
                 return null;
@@ -67,46 +93,73 @@ pub fn MyRingBuffer(comptime T: type) type {
             return self.data[self.last];
         }
 
+        /// The elements in order, as two contiguous regions. The second one
+        /// is empty unless the elements wrap around the end of the buffer.
+        /// e.g. to writev(2) them out, then discard what was written
+        pub fn readableSlices(self: Self) [2][]T {
+            const end = self.first + self.len;
+            if (end <= self.data.len) {
+                return .{ self.data[self.first..end], self.data[0..0] };
+            }
+            return .{ self.data[self.first..], self.data[0 .. end - self.data.len] };
+        }
+
+        /// The free space after the last element, as two contiguous regions
+        /// e.g. to readv(2) into them, then commitWritten what was read
+        pub fn writableSlices(self: Self) [2][]T {
+            const end = self.last + self.data.len - self.len;
+            if (end <= self.data.len) {
+                return .{ self.data[self.last..end], self.data[0..0] };
+            }
+            return .{ self.data[self.last..], self.data[0 .. end - self.data.len] };
+        }
+
+        /// Makes the first `n` elements of writableSlices part of the buffer
+        pub fn commitWritten(self: *Self, n: usize) void {
+            assert(n <= self.data.len - self.len);
+            self.last = (self.last + n) & self.mask();
+            self.len += n;
+        }
+
+        /// Drops the first `n` elements
+        pub fn discard(self: *Self, n: usize) void {
+            assert(n <= self.len);
+            self.first = (self.first + n) & self.mask();
+            self.len -= n;
+        }
+
         /// asserts idx < self.len
         pub fn at(self: Self, idx: usize) T {
             assert(idx < self.len);
-            idx = (idx + self.first) % self.data.len;
-            assert(idx < self.last);
-            return self.items[idx];
+            return self.data[(self.first + idx) & self.mask()];
+        }
+
+        fn mask(self: Self) usize {
+            return self.data.len -% 1;
         }
+
         pub fn idxBefore(self: Self, idx: usize) usize {
-            const res = (self.data.len + idx - 1) % self.data.len;
-            assert(res >= 0);
-            assert(res < self.data.len);
-            return res;
+            return (idx -% 1) & self.mask();
         }
+
         pub fn idxAfter(self: Self, idx: usize) usize {
-            const res = (idx + 1) % self.data.len;
-            assert(res >= 0);
-            assert(res < self.data.len);
-            return res;
+            return (idx + 1) & self.mask();
         }
 
+        /// Rounds the capacity up to a power of two, and moves the elements
+        /// to the front of the new buffer
         pub fn ensureCapacity(self: *Self, capacity: usize) !void {
             if (capacity <= self.data.len) return;
 
-            var newcapacity = self.data.len;
-            while (newcapacity < capacity) : (newcapacity |= (newcapacity + 1) * 2) {}
-
+            const newcapacity = std.math.ceilPowerOfTwo(usize, capacity) catch return error.OutOfMemory;
             const newdata = try self.allocator.alloc(T, newcapacity);
-            const newfirst = (newdata.len - self.len) / 2;
-            const newlast = newfirst + self.len;
-            if (self.first < self.last) {
-                @memcpy(newdata[newfirst..newlast], self.data[self.first..self.last]);
-            } else {
-                const mid = newfirst + (self.data.len - self.first);
-                @memcpy(newdata[newfirst..mid], self.data[self.first..]);
-                @memcpy(newdata[mid..newlast], self.data[0..self.last]);
-            }
-            self.first = newfirst;
-            self.last = newlast;
+            const parts = self.readableSlices();
+            @memcpy(newdata[0..parts[0].len], parts[0]);
+            @memcpy(newdata[parts[0].len..self.len], parts[1]);
             self.allocator.free(self.data);
             self.data = newdata;
+            self.first = 0;
+            self.last = self.len;
         }
     };
 }
@@ -208,3 +261,95 @@ test "MyRingBuffer" {
     try std.testing.expectEqual(null, rb.popLast());
     try std.testing.expect(rb.empty());
 }
+
+test "MyRingBuffer at" {
+    const allocator = std.testing.allocator;
+    var rb = MyRingBuffer(u32).init(allocator);
+    defer rb.deinit();
+
+    var i: u32 = 0;
+    while (i < 5) : (i += 1) {
+        try rb.append(i + 10);
+        try rb.prepend(9 - i);
+    }
+    try std.testing.expect(std.math.isPowerOfTwo(rb.data.len));
+    for (0..10) |idx| {
+        try std.testing.expectEqual(idx + 5, rb.at(idx));
+    }
+}
+
+test "MyRingBuffer bulk" {
+    const allocator = std.testing.allocator;
+    var rb = MyRingBuffer(u8).init(allocator);
+    defer rb.deinit();
+
+    var out: [16]u8 = undefined;
+    try std.testing.expectEqual(0, rb.popFirstInto(&out));
+
+    try rb.appendSlice("abcdef");
+    try std.testing.expectEqual(8, rb.data.len);
+    try std.testing.expectEqual(4, rb.popFirstInto(out[0..4]));
+    try std.testing.expectEqualSlices(u8, "abcd", out[0..4]);
+
+    // Wraps around the end of the buffer
+    try rb.appendSlice("ghijk");
+    try std.testing.expectEqual(8, rb.data.len);
+    const parts = rb.readableSlices();
+    try std.testing.expectEqualSlices(u8, "efgh", parts[0]);
+    try std.testing.expectEqualSlices(u8, "ijk", parts[1]);
+    try std.testing.expectEqual('i', rb.at(4));
+
+    const free = rb.writableSlices();
+    try std.testing.expectEqual(1, free[0].len + free[1].len);
+
+    // Grows and unwraps
+    try rb.appendSlice("lmnopqrstu");
+    try std.testing.expectEqual(32, rb.data.len);
+    try std.testing.expectEqual(16, rb.popFirstInto(&out));
+    try std.testing.expectEqualSlices(u8, "efghijklmnopqrst", &out);
+    try std.testing.expectEqual(1, rb.popFirstInto(&out));
+    try std.testing.expectEqual('u', out[0]);
+    try std.testing.expect(rb.empty());
+}
+
+test "MyRingBuffer readv and writev" {
+    if (@import("builtin").os.tag == .windows) return error.SkipZigTest;
+
+    const allocator = std.testing.allocator;
+    var rb = MyRingBuffer(u8).init(allocator);
+    defer rb.deinit();
+    try rb.ensureCapacity(8);
+
+    const fds = try std.posix.pipe();
+    defer std.posix.close(fds[0]);
+    defer std.posix.close(fds[1]);
+
+    // Leave the free space wrapped around the end
+    try rb.appendSlice("xxxxx");
+    rb.discard(5);
+
+    _ = try std.posix.write(fds[1], "0123456");
+    const free = rb.writableSlices();
+    const read_iov = [_]std.posix.iovec{
+        .{ .base = free[0].ptr, .len = free[0].len },
+        .{ .base = free[1].ptr, .len = free[1].len },
+    };
+    const got = try std.posix.readv(fds[0], &read_iov);
+    try std.testing.expectEqual(7, got);
+    rb.commitWritten(got);
+
+    const parts = rb.readableSlices();
+    try std.testing.expectEqual(3, parts[0].len);
+    const write_iov = [_]std.posix.iovec_const{
+        .{ .base = parts[0].ptr, .len = parts[0].len },
+        .{ .base = parts[1].ptr, .len = parts[1].len },
+    };
+    const put = try std.posix.writev(fds[1], &write_iov);
+    try std.testing.expectEqual(7, put);
+    rb.discard(put);
+    try std.testing.expect(rb.empty());
+
+    var out: [7]u8 = undefined;
+    try std.testing.expectEqual(7, try std.posix.read(fds[0], &out));
+    try std.testing.expectEqualSlices(u8, "0123456", &out);
+}
@@ -0,0 +1,232 @@
+const std = @import("std");
+const math = std.math;
+
+/// Scalar type of the vector lanes used to search slices of T, or null when
+/// T can't be compared lane by lane: only ints, floats and enums whose bits
+/// fill their bytes exactly, with a power of two size.
+fn LaneOf(comptime T: type) ?type {
+    const L = switch (@typeInfo(T)) {
+        .int, .float => T,
+        .@"enum" => |info| info.tag_type,
+        else => return null,
+    };
+    if (@bitSizeOf(L) != @sizeOf(T) * 8 or !math.isPowerOfTwo(@bitSizeOf(L))) {
+        return null;
+    }
+    return L;
+}
+
+/// Number of lanes of the vectors used to search slices of T, null when the
+/// search falls back to comparing one element at a time
+fn vectorLen(comptime T: type) ?comptime_int {
+    const L = LaneOf(T) orelse return null;
+    return std.simd.suggestVectorLength(L);
+}
+
+/// Whether searching a slice of T compares several elements per instruction
+pub fn vectorizable(comptime T: type) bool {
+    return vectorLen(T) != null;
+}
+
+fn toLane(comptime T: type, val: T) LaneOf(T).? {
+    return if (@typeInfo(T) == .@"enum") @intFromEnum(val) else val;
+}
+
+fn Searcher(comptime T: type) type {
+    return struct {
+        const L = LaneOf(T).?;
+        const n = vectorLen(T).?;
+        const V = @Vector(n, L);
+        /// Bit i is set when lane i matched
+        const Mask = std.meta.Int(.unsigned, n);
+
+        fn lanes(items: []const T) []const L {
+            return @ptrCast(items);
+        }
+
+        fn load(items: []const L, i: usize) V {
+            return items[i..][0..n].*;
+        }
+
+        fn matches(chunk: V, val: T) Mask {
+            const needle: V = @splat(toLane(T, val));
+            return @bitCast(chunk == needle);
+        }
+    };
+}
+
+/// O(n)
+/// Returns the index of the first occurence of `val` at or after `start`
+pub fn indexOfPos(comptime T: type, items: []const T, start: usize, val: T) ?usize {
+    var i = start;
+    if (comptime vectorizable(T)) {
+        const S = Searcher(T);
+        const data = S.lanes(items);
+        while (i + S.n <= data.len) : (i += S.n) {
+            const mask = S.matches(S.load(data, i), val);
+            if (mask != 0) return i + @ctz(mask);
+        }
+    }
+    while (i < items.len) : (i += 1) {
+        if (items[i] == val) return i;
+    }
+    return null;
+}
+
+/// O(n)
+/// Returns the index of the last occurence of `val`
+pub fn lastIndexOf(comptime T: type, items: []const T, val: T) ?usize {
+    var i = items.len;
+    if (comptime vectorizable(T)) {
+        const S = Searcher(T);
+        const data = S.lanes(items);
+        while (i >= S.n) {
+            i -= S.n;
+            const mask = S.matches(S.load(data, i), val);
+            if (mask != 0) return i + S.n - 1 - @clz(mask);
+        }
+    }
+    while (i > 0) {
+        i -= 1;
+        if (items[i] == val) return i;
+    }
+    return null;
+}
+
+/// O(n)
+/// Returns the number of occurences of `val`
+pub fn count(comptime T: type, items: []const T, val: T) usize {
+    var res: usize = 0;
+    var i: usize = 0;
+    if (comptime vectorizable(T)) {
+        const S = Searcher(T);
+        const data = S.lanes(items);
+        while (i + S.n <= data.len) : (i += S.n) {
+            res += @popCount(S.matches(S.load(data, i), val));
+        }
+    }
+    for (items[i..]) |v| {
+        res += @intFromBool(v == val);
+    }
+    return res;
+}
+
+/// O(n * vals.len)
+/// Returns the index of the first element at or after `start` equal to any of
+/// `vals`. Each chunk is loaded once and compared against all of `vals`.
+pub fn indexOfAnyPos(comptime T: type, items: []const T, start: usize, vals: []const T) ?usize {
+    var i = start;
+    if (comptime vectorizable(T)) {
+        const S = Searcher(T);
+        const data = S.lanes(items);
+        while (i + S.n <= data.len) : (i += S.n) {
+            const chunk = S.load(data, i);
+            var mask: S.Mask = 0;
+            for (vals) |val| {
+                mask |= S.matches(chunk, val);
+            }
+            if (mask != 0) return i + @ctz(mask);
+        }
+    }
+    while (i < items.len) : (i += 1) {
+        for (vals) |val| {
+            if (items[i] == val) return i;
+        }
+    }
+    return null;
+}
+
+const expectEqual = std.testing.expectEqual;
+
+test "LaneOf" {
+    const Color = enum(u8) { red, green, blue };
+    const Small = enum(u2) { a, b, c };
+    comptime {
+        std.debug.assert(LaneOf(u8).? == u8);
+        std.debug.assert(LaneOf(f64).? == f64);
+        std.debug.assert(LaneOf(Color).? == u8);
+        std.debug.assert(LaneOf(Small) == null);
+        std.debug.assert(LaneOf(u24) == null);
+        std.debug.assert(LaneOf(bool) == null);
+        std.debug.assert(LaneOf(struct { a: u32 }) == null);
+    }
+}
+
+/// Checks all searches against plain loops, for every start position of
+/// every length up to `items.len`, so that needles land in the vector body,
+/// the scalar tail and across chunk boundaries
+fn checkSearches(comptime T: type, items: []const T, val: T, other: T) !void {
+    for (0..items.len + 1) |len| {
+        const slice = items[0..len];
+
+        var expected_count: usize = 0;
+        var expected_last: ?usize = null;
+        for (slice, 0..) |v, i| {
+            if (v == val) {
+                expected_count += 1;
+                expected_last = i;
+            }
+        }
+        try expectEqual(expected_count, count(T, slice, val));
+        try expectEqual(expected_last, lastIndexOf(T, slice, val));
+
+        for (0..len + 2) |start| {
+            var expected: ?usize = null;
+            var expected_any: ?usize = null;
+            var i = start;
+            while (i < len) : (i += 1) {
+                if (expected_any == null and (slice[i] == val or slice[i] == other)) {
+                    expected_any = i;
+                }
+                if (slice[i] == val) {
+                    expected = i;
+                    break;
+                }
+            }
+            try expectEqual(expected, indexOfPos(T, slice, start, val));
+            try expectEqual(expected_any, indexOfAnyPos(T, slice, start, &[_]T{ val, other }));
+        }
+    }
+}
+
+test "search ints" {
+    var bytes: [150]u8 = undefined;
+    var words: [150]u32 = undefined;
+    var longs: [150]i64 = undefined;
+    for (0..bytes.len) |i| {
+        bytes[i] = @intCast(i * 7 % 13);
+        words[i] = @intCast(i * 7 % 13 + 1000);
+        longs[i] = @as(i64, @intCast(i * 7 % 13)) - 5;
+    }
+    try checkSearches(u8, &bytes, 3, 11);
+    try checkSearches(u8, &bytes, 200, 0);
+    try checkSearches(u32, &words, 1003, 1012);
+    try checkSearches(i64, &longs, -2, 7);
+    try checkSearches(i64, &longs, 100, 100);
+}
+
+test "search floats" {
+    var floats: [100]f32 = undefined;
+    for (0..floats.len) |i| {
+        floats[i] = @floatFromInt(i % 9);
+    }
+    floats[50] = -0.0;
+    floats[77] = math.nan(f32);
+    try checkSearches(f32, &floats, 4.0, 0.0);
+    // NaN never compares equal, in the vector body as in the tail
+    try expectEqual(null, indexOfPos(f32, &floats, 0, math.nan(f32)));
+    try expectEqual(0, count(f32, &floats, math.nan(f32)));
+}
+
+test "search enums" {
+    const Color = enum(u8) { red, green, blue, _ };
+    const Small = enum(u2) { a, b, c, d };
+    var colors: [90]Color = undefined;
+    var smalls: [90]Small = undefined;
+    for (0..colors.len) |i| {
+        colors[i] = @enumFromInt(i % 5);
+        smalls[i] = @enumFromInt(i % 3);
+    }
+    try checkSearches(Color, &colors, .blue, @enumFromInt(4));
+    try checkSearches(Small, &smalls, .c, .d);
+}
@@ -0,0 +1,633 @@
+const std = @import("std");
+const math = std.math;
+const assert = std.debug.assert;
+
+/// Slices this short are insertion sorted
+const insertion_threshold = 24;
+/// Above this length, the pivot is the median of 3 medians of 3
+const ninther_threshold = 128;
+/// partialInsertionSort gives up after moving this many elements
+const partial_insertion_limit = 8;
+/// sortStable insertion sorts runs of this length before merging them
+const stable_run = 16;
+
+/// O(n log n), not stable, in place
+/// Pattern-defeating quicksort: quicksort with median of 3 (or 9) pivots, that
+/// detects already sorted runs, groups elements equal to the pivot when they
+/// repeat, and falls back to heapsort when partitions stay unbalanced.
+/// `lessThan` is comptime so that it gets inlined in the loops.
+pub fn sort(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    if (items.len < 2) return;
+    const bad_allowed: u32 = math.log2_int(usize, items.len);
+    pdqLoop(T, items, context, lessThan, null, bad_allowed);
+}
+
+/// O(n log n) with a scratch buffer of at least half the length, O(n log² n)
+/// without, stable, in place
+/// Bottom-up merge sort: runs are insertion sorted then merged pairwise.
+/// Merges go through `scratch` when it is big enough for the left run, and
+/// are done in place by rotations otherwise, so no allocation ever happens.
+pub fn sortStable(
+    comptime T: type,
+    items: []T,
+    scratch: ?[]T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    const n = items.len;
+    var start: usize = 0;
+    while (start < n) : (start += stable_run) {
+        insertionSort(T, items[start..@min(start + stable_run, n)], context, lessThan);
+    }
+
+    var width: usize = stable_run;
+    while (width < n) : (width *= 2) {
+        start = 0;
+        while (start + width < n) : (start += 2 * width) {
+            const mid = start + width;
+            const end = @min(start + 2 * width, n);
+            // Already in order, nothing to merge
+            if (!lessThan(context, items[mid], items[mid - 1])) continue;
+
+            if (scratch) |buf| {
+                if (buf.len >= width) {
+                    mergeBuffered(T, items[start..end], width, buf, context, lessThan);
+                    continue;
+                }
+            }
+            mergeInPlace(T, items, start, mid, end, context, lessThan);
+        }
+    }
+}
+
+/// O(n) on average, in place
+/// Reorders `items` so that items[nth] is the element that would be there if
+/// they were sorted, with no greater element before it and no lesser one
+/// after it.
+/// Asserts nth < items.len
+pub fn nthElement(
+    comptime T: type,
+    items_in: []T,
+    nth_in: usize,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    assert(nth_in < items_in.len);
+    var items = items_in;
+    var nth = nth_in;
+    // Value right before `items` once narrowed to a right part, not greater
+    // than any of them
+    var pred: ?T = null;
+    var bad: u32 = math.log2_int(usize, items.len);
+
+    while (items.len > insertion_threshold) {
+        choosePivot(T, items, context, lessThan);
+
+        if (pred) |p| {
+            if (!lessThan(context, p, items[0])) {
+                // The pivot repeats, its copies all end up on the left
+                const pos = partitionLeft(T, items, context, lessThan);
+                if (nth <= pos) return;
+                items = items[pos + 1 ..];
+                nth -= pos + 1;
+                continue;
+            }
+        }
+
+        const res = partitionRight(T, items, context, lessThan);
+        if (nth == res.pivot) return;
+
+        const unbalanced = res.pivot < items.len / 8 or items.len - res.pivot < items.len / 8;
+        if (unbalanced) {
+            bad -= 1;
+            if (bad == 0) {
+                heapSort(T, items, context, lessThan);
+                return;
+            }
+        }
+
+        if (nth < res.pivot) {
+            items = items[0..res.pivot];
+        } else {
+            pred = items[res.pivot];
+            items = items[res.pivot + 1 ..];
+            nth -= res.pivot + 1;
+        }
+    }
+    insertionSort(T, items, context, lessThan);
+}
+
+/// O(n + k log k), in place
+/// Sorts the `k` smallest elements into items[0..k], the others end up in
+/// items[k..] in no particular order
+pub fn partialSort(
+    comptime T: type,
+    items: []T,
+    k: usize,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    if (k == 0) return;
+    if (k < items.len) {
+        nthElement(T, items, k - 1, context, lessThan);
+    }
+    sort(T, items[0..@min(k, items.len)], context, lessThan);
+}
+
+fn pdqLoop(
+    comptime T: type,
+    items_in: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+    pred_in: ?T,
+    bad_in: u32,
+) void {
+    var items = items_in;
+    var pred = pred_in;
+    var bad = bad_in;
+
+    while (true) {
+        const n = items.len;
+        if (n <= insertion_threshold) {
+            insertionSort(T, items, context, lessThan);
+            return;
+        }
+
+        choosePivot(T, items, context, lessThan);
+
+        // The pivot being equal to the element before the slice, which is not
+        // greater than any element in it, the pivot is the minimum. Group all
+        // its copies on the left and only keep going with the greater ones.
+        // This makes many duplicates linear instead of quadratic
+        if (pred) |p| {
+            if (!lessThan(context, p, items[0])) {
+                const pos = partitionLeft(T, items, context, lessThan);
+                items = items[pos + 1 ..];
+                continue;
+            }
+        }
+
+        const res = partitionRight(T, items, context, lessThan);
+        const left = items[0..res.pivot];
+        const right = items[res.pivot + 1 ..];
+
+        if (left.len < n / 8 or right.len < n / 8) {
+            bad -= 1;
+            if (bad == 0) {
+                heapSort(T, items, context, lessThan);
+                return;
+            }
+            breakPatterns(T, left);
+            breakPatterns(T, right);
+        } else if (res.already_partitioned and
+            partialInsertionSort(T, left, context, lessThan) and
+            partialInsertionSort(T, right, context, lessThan))
+        {
+            // The input was probably sorted already
+            return;
+        }
+
+        // Recurse into the smaller side, so that the stack stays in O(log n)
+        const pivot = items[res.pivot];
+        if (left.len < right.len) {
+            pdqLoop(T, left, context, lessThan, pred, bad);
+            items = right;
+            pred = pivot;
+        } else {
+            pdqLoop(T, right, context, lessThan, pivot, bad);
+            items = left;
+        }
+    }
+}
+
+/// Orders items[a] <= items[b] <= items[c]
+fn sort3(
+    comptime T: type,
+    items: []T,
+    a: usize,
+    b: usize,
+    c: usize,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    if (lessThan(context, items[b], items[a])) std.mem.swap(T, &items[a], &items[b]);
+    if (lessThan(context, items[c], items[b])) std.mem.swap(T, &items[b], &items[c]);
+    if (lessThan(context, items[b], items[a])) std.mem.swap(T, &items[a], &items[b]);
+}
+
+/// Moves the pivot to items[0]. Also leaves an element not lesser than the
+/// pivot at the end, that partitionRight relies on
+fn choosePivot(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    const n = items.len;
+    const half = n / 2;
+    if (n > ninther_threshold) {
+        sort3(T, items, 0, half, n - 1, context, lessThan);
+        sort3(T, items, 1, half - 1, n - 2, context, lessThan);
+        sort3(T, items, 2, half + 1, n - 3, context, lessThan);
+        sort3(T, items, half - 1, half, half + 1, context, lessThan);
+        std.mem.swap(T, &items[0], &items[half]);
+    } else {
+        sort3(T, items, half, 0, n - 1, context, lessThan);
+    }
+}
+
+const Partition = struct {
+    /// Final index of the pivot
+    pivot: usize,
+    /// No element had to be swapped
+    already_partitioned: bool,
+};
+
+/// Partitions around items[0]: lesser elements end up before it, the others
+/// after it
+fn partitionRight(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) Partition {
+    const pivot = items[0];
+    var first: usize = 1;
+    var last: usize = items.len;
+
+    // choosePivot left a greater or equal element at the end, no bound check
+    while (lessThan(context, items[first], pivot)) first += 1;
+    if (first == 1) {
+        while (first < last) {
+            last -= 1;
+            if (lessThan(context, items[last], pivot)) break;
+        }
+    } else {
+        // items[first - 1] is lesser, no bound check
+        last -= 1;
+        while (!lessThan(context, items[last], pivot)) last -= 1;
+    }
+
+    const already_partitioned = first >= last;
+    while (first < last) {
+        std.mem.swap(T, &items[first], &items[last]);
+        first += 1;
+        while (lessThan(context, items[first], pivot)) first += 1;
+        last -= 1;
+        while (!lessThan(context, items[last], pivot)) last -= 1;
+    }
+
+    const pos = first - 1;
+    items[0] = items[pos];
+    items[pos] = pivot;
+    return .{ .pivot = pos, .already_partitioned = already_partitioned };
+}
+
+/// Partitions around items[0]: elements not greater end up before it, the
+/// others after it. Returns the final index of the pivot
+fn partitionLeft(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) usize {
+    const pivot = items[0];
+    var first: usize = 0;
+    var last: usize = items.len - 1;
+
+    // The pivot itself stops this one
+    while (lessThan(context, pivot, items[last])) last -= 1;
+    if (last + 1 == items.len) {
+        while (first < last) {
+            first += 1;
+            if (lessThan(context, pivot, items[first])) break;
+        }
+    } else {
+        // items[last + 1] is greater, no bound check
+        first += 1;
+        while (!lessThan(context, pivot, items[first])) first += 1;
+    }
+
+    while (first < last) {
+        std.mem.swap(T, &items[first], &items[last]);
+        last -= 1;
+        while (lessThan(context, pivot, items[last])) last -= 1;
+        first += 1;
+        while (!lessThan(context, pivot, items[first])) first += 1;
+    }
+
+    items[0] = items[last];
+    items[last] = pivot;
+    return last;
+}
+
+/// Swaps a few elements at fixed places, so that adversarial or periodic
+/// inputs don't keep producing bad pivots
+fn breakPatterns(comptime T: type, items: []T) void {
+    const n = items.len;
+    if (n < insertion_threshold) return;
+    const quarter = n / 4;
+    std.mem.swap(T, &items[0], &items[quarter]);
+    std.mem.swap(T, &items[n - 1], &items[n - quarter]);
+    if (n > ninther_threshold) {
+        std.mem.swap(T, &items[1], &items[quarter + 1]);
+        std.mem.swap(T, &items[2], &items[quarter + 2]);
+        std.mem.swap(T, &items[n - 2], &items[n - quarter - 1]);
+        std.mem.swap(T, &items[n - 3], &items[n - quarter - 2]);
+    }
+}
+
+/// Stable
+fn insertionSort(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    for (1..@max(items.len, 1)) |i| {
+        const tmp = items[i];
+        var j = i;
+        while (j > 0 and lessThan(context, tmp, items[j - 1])) : (j -= 1) {
+            items[j] = items[j - 1];
+        }
+        items[j] = tmp;
+    }
+}
+
+/// Insertion sort that gives up once it moved too many elements
+/// Returns whether the slice is sorted
+fn partialInsertionSort(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) bool {
+    var moved: usize = 0;
+    for (1..@max(items.len, 1)) |i| {
+        if (!lessThan(context, items[i], items[i - 1])) continue;
+
+        const tmp = items[i];
+        var j = i;
+        while (j > 0 and lessThan(context, tmp, items[j - 1])) : (j -= 1) {
+            items[j] = items[j - 1];
+        }
+        items[j] = tmp;
+        moved += i - j;
+        if (moved > partial_insertion_limit) return false;
+    }
+    return true;
+}
+
+fn heapSort(
+    comptime T: type,
+    items: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    var i = items.len / 2;
+    while (i > 0) {
+        i -= 1;
+        siftDown(T, items, i, context, lessThan);
+    }
+    var end = items.len;
+    while (end > 1) {
+        end -= 1;
+        std.mem.swap(T, &items[0], &items[end]);
+        siftDown(T, items[0..end], 0, context, lessThan);
+    }
+}
+
+fn siftDown(
+    comptime T: type,
+    items: []T,
+    root_in: usize,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    var root = root_in;
+    while (true) {
+        var child = 2 * root + 1;
+        if (child >= items.len) return;
+        if (child + 1 < items.len and lessThan(context, items[child], items[child + 1])) {
+            child += 1;
+        }
+        if (!lessThan(context, items[root], items[child])) return;
+        std.mem.swap(T, &items[root], &items[child]);
+        root = child;
+    }
+}
+
+/// Merges items[0..mid] and items[mid..], copying the left run to `buf`
+fn mergeBuffered(
+    comptime T: type,
+    items: []T,
+    mid: usize,
+    buf: []T,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    const left = buf[0..mid];
+    @memcpy(left, items[0..mid]);
+
+    var i: usize = 0;
+    var j: usize = mid;
+    var k: usize = 0;
+    // The write index never catches up with j, so the right run is read
+    // before being overwritten
+    while (i < left.len and j < items.len) : (k += 1) {
+        // Ties take from the left run, which keeps the sort stable
+        if (lessThan(context, items[j], left[i])) {
+            items[k] = items[j];
+            j += 1;
+        } else {
+            items[k] = left[i];
+            i += 1;
+        }
+    }
+    // Leftovers of the right run are already in place
+    @memcpy(items[k .. k + left.len - i], left[i..]);
+}
+
+/// Merges items[a..m] and items[m..b] without extra memory, by rotating
+/// blocks into place (SymMerge, Kim & Kutzner)
+fn mergeInPlace(
+    comptime T: type,
+    items: []T,
+    a: usize,
+    m: usize,
+    b: usize,
+    context: anytype,
+    comptime lessThan: fn (@TypeOf(context), T, T) bool,
+) void {
+    if (m - a == 1) {
+        // Binary search the place of the single left element
+        var lo = m;
+        var hi = b;
+        while (lo < hi) {
+            const h = lo + (hi - lo) / 2;
+            if (lessThan(context, items[h], items[a])) lo = h + 1 else hi = h;
+        }
+        std.mem.rotate(T, items[a..lo], 1);
+        return;
+    }
+    if (b - m == 1) {
+        // Binary search the place of the single right element
+        var lo = a;
+        var hi = m;
+        while (lo < hi) {
+            const h = lo + (hi - lo) / 2;
+            if (!lessThan(context, items[m], items[h])) lo = h + 1 else hi = h;
+        }
+        std.mem.rotate(T, items[lo .. m + 1], m - lo);
+        return;
+    }
+
+    const mid = a + (b - a) / 2;
+    const n = mid + m;
+    var start: usize = undefined;
+    var r: usize = undefined;
+    if (m > mid) {
+        start = n - b;
+        r = mid;
+    } else {
+        start = a;
+        r = m;
+    }
+    const p = n - 1;
+    while (start < r) {
+        const c = start + (r - start) / 2;
+        if (!lessThan(context, items[p - c], items[c])) start = c + 1 else r = c;
+    }
+
+    const end = n - start;
+    if (start < m and m < end) {
+        std.mem.rotate(T, items[start..end], m - start);
+    }
+    if (a < start and start < mid) {
+        mergeInPlace(T, items, a, start, mid, context, lessThan);
+    }
+    if (mid < end and end < b) {
+        mergeInPlace(T, items, mid, end, b, context, lessThan);
+    }
+}
+
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+const expectEqualSlices = std.testing.expectEqualSlices;
+
+const asc_u32 = std.sort.asc(u32);
+
+/// Inputs that are known to be hard on quicksorts
+fn fillPattern(items: []u32, pattern: usize, random: std.Random) void {
+    const n: u32 = @intCast(items.len);
+    for (items, 0..) |*item, idx| {
+        const i: u32 = @intCast(idx);
+        item.* = switch (pattern) {
+            0 => random.int(u32),
+            1 => i,
+            2 => n - i,
+            3 => 42,
+            4 => random.uintLessThan(u32, 4),
+            5 => i % 17,
+            6 => if (i < n / 2) i else n - i,
+            7 => if (i % 97 == 0) random.int(u32) else i,
+            else => unreachable,
+        };
+    }
+}
+
+test "sort" {
+    const alloc = std.testing.allocator;
+    var prng = std.Random.DefaultPrng.init(42);
+    const random = prng.random();
+
+    for ([_]usize{ 0, 1, 2, 3, 10, 24, 25, 100, 129, 1000, 10000 }) |n| {
+        const items = try alloc.alloc(u32, n);
+        defer alloc.free(items);
+        const expected = try alloc.alloc(u32, n);
+        defer alloc.free(expected);
+
+        for (0..8) |pattern| {
+            fillPattern(items, pattern, random);
+            @memcpy(expected, items);
+            std.mem.sort(u32, expected, {}, asc_u32);
+
+            sort(u32, items, {}, asc_u32);
+            expectEqualSlices(u32, expected, items) catch |err| {
+                std.debug.print("For n = {d}, pattern {d}\n", .{ n, pattern });
+                return err;
+            };
+        }
+    }
+}
+
+const Pair = struct { key: u32, order: u32 };
+
+fn pairLessThan(_: void, a: Pair, b: Pair) bool {
+    return a.key < b.key;
+}
+
+test "sortStable" {
+    const alloc = std.testing.allocator;
+    var prng = std.Random.DefaultPrng.init(42);
+    const random = prng.random();
+
+    for ([_]usize{ 0, 1, 2, 15, 16, 17, 100, 1000, 5000 }) |n| {
+        const items = try alloc.alloc(Pair, n);
+        defer alloc.free(items);
+        const scratch = try alloc.alloc(Pair, n / 2 + 1);
+        defer alloc.free(scratch);
+
+        // With a big enough scratch buffer, a too small one, and none
+        for ([_]?[]Pair{ scratch, scratch[0..@min(scratch.len, 20)], null }) |buf| {
+            for (items, 0..) |*item, i| {
+                item.* = .{ .key = random.uintLessThan(u32, 50), .order = @intCast(i) };
+            }
+            sortStable(Pair, items, buf, {}, pairLessThan);
+
+            for (1..@max(n, 1)) |i| {
+                const a = items[i - 1];
+                const b = items[i];
+                try expect(a.key < b.key or (a.key == b.key and a.order < b.order));
+            }
+        }
+    }
+}
+
+test "nthElement and partialSort" {
+    const alloc = std.testing.allocator;
+    var prng = std.Random.DefaultPrng.init(42);
+    const random = prng.random();
+
+    for ([_]usize{ 1, 2, 10, 30, 200, 5000 }) |n| {
+        const items = try alloc.alloc(u32, n);
+        defer alloc.free(items);
+        const sorted = try alloc.alloc(u32, n);
+        defer alloc.free(sorted);
+
+        for (0..8) |pattern| {
+            fillPattern(items, pattern, random);
+            @memcpy(sorted, items);
+            std.mem.sort(u32, sorted, {}, asc_u32);
+
+            const nth = random.uintLessThan(usize, n);
+            nthElement(u32, items, nth, {}, asc_u32);
+            try expectEqual(sorted[nth], items[nth]);
+            for (items[0..nth]) |item| try expect(item <= items[nth]);
+            for (items[nth..]) |item| try expect(item >= items[nth]);
+
+            fillPattern(items, pattern, random);
+            @memcpy(sorted, items);
+            std.mem.sort(u32, sorted, {}, asc_u32);
+
+            const k = random.uintAtMost(usize, n);
+            partialSort(u32, items, k, {}, asc_u32);
+            try expectEqualSlices(u32, sorted[0..k], items[0..k]);
+        }
+    }
+}
@@ -0,0 +1,280 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const Futex = std.Thread.Futex;
+const assert = std.debug.assert;
+
+/// Fixed capacity queue between exactly one producer thread and one consumer
+/// thread, without locks.
+///
+/// head and tail count the items ever popped and pushed, wrapping around, and
+/// live on separate cache lines so that each side only writes to its own.
+/// Each side also keeps the last value it saw of the other side's index, and
+/// only reads the shared one when that copy says the ring is full (or empty),
+/// so most operations touch no cache line written by the other thread.
+///
+/// The wait helpers spin for a while then sleep on a futex. A side only pays
+/// for a wake-up syscall when the other one is actually asleep.
+pub fn MySpscRing(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        const cache_line = std.atomic.cache_line;
+        /// Polls of the other side's index before going to sleep
+        const spin_limit = 1024;
+
+        const Producer = struct {
+            tail: std.atomic.Value(u32) align(cache_line),
+            cached_head: u32,
+        };
+
+        const Consumer = struct {
+            head: std.atomic.Value(u32) align(cache_line),
+            cached_tail: u32,
+        };
+
+        const Sleepers = struct {
+            producer: std.atomic.Value(bool) align(cache_line),
+            consumer: std.atomic.Value(bool),
+        };
+
+        allocator: Allocator,
+        /// Power of two length
+        data: []T,
+        producer: Producer,
+        consumer: Consumer,
+        sleepers: Sleepers,
+
+        /// Rounds the capacity up to a power of two, up to 2^31
+        /// The ring must not move once the threads use it.
+        pub fn init(allocator: Allocator, capacity: usize) !Self {
+            assert(capacity > 0 and capacity <= 1 << 31);
+            const data = try allocator.alloc(T, try std.math.ceilPowerOfTwo(usize, capacity));
+            return Self{
+                .allocator = allocator,
+                .data = data,
+                .producer = .{ .tail = .init(0), .cached_head = 0 },
+                .consumer = .{ .head = .init(0), .cached_tail = 0 },
+                .sleepers = .{ .producer = .init(false), .consumer = .init(false) },
+            };
+        }
+
+        pub fn deinit(self: Self) void {
+            self.allocator.free(self.data);
+        }
+
+        fn capacity(self: Self) u32 {
+            return @intCast(self.data.len);
+        }
+
+        /// Number of items, only a hint while the other thread runs
+        pub fn len(self: *const Self) usize {
+            return self.producer.tail.load(.acquire) -% self.consumer.head.load(.acquire);
+        }
+
+        // Producer side
+
+        /// Pushes as many items as fit, with a single publication of the tail
+        /// Returns the number of items pushed
+        pub fn pushSlice(self: *Self, items: []const T) usize {
+            const p = &self.producer;
+            const tail = p.tail.load(.monotonic);
+            var free = self.capacity() - (tail -% p.cached_head);
+            if (free < items.len) {
+                p.cached_head = self.consumer.head.load(.acquire);
+                free = self.capacity() - (tail -% p.cached_head);
+            }
+            const n: u32 = @intCast(@min(free, items.len));
+            if (n == 0) return 0;
+
+            const start = tail & (self.capacity() - 1);
+            const first = @min(n, self.capacity() - start);
+            @memcpy(self.data[start..][0..first], items[0..first]);
+            @memcpy(self.data[0 .. n - first], items[first..n]);
+            self.publishTail(tail +% n);
+            return n;
+        }
+
+        pub fn tryPush(self: *Self, item: T) bool {
+            return self.pushSlice(&[_]T{item}) == 1;
+        }
+
+        /// Pushes all items, waiting for room as needed
+        pub fn pushSliceWait(self: *Self, items: []const T) void {
+            var done: usize = 0;
+            while (true) {
+                done += self.pushSlice(items[done..]);
+                if (done == items.len) return;
+                self.waitPushable();
+            }
+        }
+
+        pub fn push(self: *Self, item: T) void {
+            self.pushSliceWait(&[_]T{item});
+        }
+
+        /// Returns once there is room for at least one item
+        pub fn waitPushable(self: *Self) void {
+            const full_head = self.producer.tail.load(.monotonic) -% self.capacity();
+            const head = &self.consumer.head;
+            for (0..spin_limit) |_| {
+                if (head.load(.acquire) != full_head) return;
+                std.atomic.spinLoopHint();
+            }
+            while (true) {
+                // The consumer checks the flag after publishing its head, one
+                // of the two sees the other's store
+                self.sleepers.producer.store(true, .seq_cst);
+                if (head.load(.seq_cst) == full_head) {
+                    Futex.wait(head, full_head);
+                }
+                self.sleepers.producer.store(false, .monotonic);
+                if (head.load(.acquire) != full_head) return;
+            }
+        }
+
+        fn publishTail(self: *Self, tail: u32) void {
+            self.producer.tail.store(tail, .seq_cst);
+            if (self.sleepers.consumer.load(.seq_cst)) {
+                Futex.wake(&self.producer.tail, 1);
+            }
+        }
+
+        // Consumer side
+
+        /// Pops as many items as available into `buf`, with a single
+        /// publication of the head
+        /// Returns the number of items popped
+        pub fn popInto(self: *Self, buf: []T) usize {
+            const c = &self.consumer;
+            const head = c.head.load(.monotonic);
+            var avail = c.cached_tail -% head;
+            if (avail < buf.len) {
+                c.cached_tail = self.producer.tail.load(.acquire);
+                avail = c.cached_tail -% head;
+            }
+            const n: u32 = @intCast(@min(avail, buf.len));
+            if (n == 0) return 0;
+
+            const start = head & (self.capacity() - 1);
+            const first = @min(n, self.capacity() - start);
+            @memcpy(buf[0..first], self.data[start..][0..first]);
+            @memcpy(buf[first..n], self.data[0 .. n - first]);
+            self.publishHead(head +% n);
+            return n;
+        }
+
+        pub fn tryPop(self: *Self) ?T {
+            var buf: [1]T = undefined;
+            return if (self.popInto(&buf) == 1) buf[0] else null;
+        }
+
+        /// Pops at least one item into `buf`, waiting for one as needed
+        /// Returns the number of items popped
+        pub fn popIntoWait(self: *Self, buf: []T) usize {
+            assert(buf.len > 0);
+            while (true) {
+                const n = self.popInto(buf);
+                if (n != 0) return n;
+                self.waitPoppable();
+            }
+        }
+
+        pub fn pop(self: *Self) T {
+            var buf: [1]T = undefined;
+            _ = self.popIntoWait(&buf);
+            return buf[0];
+        }
+
+        /// Returns once there is at least one item
+        pub fn waitPoppable(self: *Self) void {
+            const head = self.consumer.head.load(.monotonic);
+            const tail = &self.producer.tail;
+            for (0..spin_limit) |_| {
+                if (tail.load(.acquire) != head) return;
+                std.atomic.spinLoopHint();
+            }
+            while (true) {
+                self.sleepers.consumer.store(true, .seq_cst);
+                if (tail.load(.seq_cst) == head) {
+                    Futex.wait(tail, head);
+                }
+                self.sleepers.consumer.store(false, .monotonic);
+                if (tail.load(.acquire) != head) return;
+            }
+        }
+
+        fn publishHead(self: *Self, head: u32) void {
+            self.consumer.head.store(head, .seq_cst);
+            if (self.sleepers.producer.load(.seq_cst)) {
+                Futex.wake(&self.consumer.head, 1);
+            }
+        }
+    };
+}
+
+const expect = std.testing.expect;
+const expectEqual = std.testing.expectEqual;
+
+test "MySpscRing" {
+    var ring = try MySpscRing(u32).init(std.testing.allocator, 5);
+    defer ring.deinit();
+
+    try expectEqual(8, ring.data.len);
+    try expectEqual(null, ring.tryPop());
+    try expect(ring.tryPush(1));
+    try expectEqual(1, ring.len());
+    try expectEqual(1, ring.tryPop());
+
+    // Wraps around the end
+    try expectEqual(8, ring.pushSlice(&[_]u32{ 2, 3, 4, 5, 6, 7, 8, 9, 10 }));
+    try expect(!ring.tryPush(11));
+    var buf: [5]u32 = undefined;
+    try expectEqual(5, ring.popInto(&buf));
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 2, 3, 4, 5, 6 }, &buf);
+    try expectEqual(5, ring.pushSlice(&[_]u32{ 11, 12, 13, 14, 15, 16 }));
+    try expectEqual(5, ring.popInto(&buf));
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 7, 8, 9, 11, 12 }, &buf);
+    try expectEqual(3, ring.popInto(&buf));
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 13, 14, 15 }, buf[0..3]);
+    try expectEqual(0, ring.len());
+}
+
+fn produce(ring: *MySpscRing(u64), n: u64, batch: usize) void {
+    var buf: [64]u64 = undefined;
+    var next: u64 = 0;
+    while (next < n) {
+        const count = @min(batch, n - next);
+        for (buf[0..count]) |*v| {
+            v.* = next;
+            next += 1;
+        }
+        ring.pushSliceWait(buf[0..count]);
+    }
+}
+
+test "MySpscRing across threads" {
+    const n = 200_000;
+    // A tiny ring and single items make both sides wait, big batches mostly
+    // don't
+    for ([_]usize{ 2, 1024 }) |capacity| {
+        for ([_]usize{ 1, 7, 64 }) |batch| {
+            var ring = try MySpscRing(u64).init(std.testing.allocator, capacity);
+            defer ring.deinit();
+
+            const producer = try std.Thread.spawn(.{}, produce, .{ &ring, n, batch });
+            var buf: [50]u64 = undefined;
+            var expected: u64 = 0;
+            while (expected < n) {
+                const got = if (batch == 1) blk: {
+                    buf[0] = ring.pop();
+                    break :blk 1;
+                } else ring.popIntoWait(&buf);
+                for (buf[0..got]) |v| {
+                    try expectEqual(expected, v);
+                    expected += 1;
+                }
+            }
+            producer.join();
+            try expectEqual(null, ring.tryPop());
+        }
+    }
+}